@@ -5,12 +5,22 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 CONFIG += c++17
 
+include(monitorcore.pri)
+
 SOURCES += \
+    archivedialog.cpp \
+    eventfiltermodel.cpp \
+    eventmodel.cpp \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    statsdialog.cpp
 
 HEADERS += \
-    mainwindow.h
+    archivedialog.h \
+    eventfiltermodel.h \
+    eventmodel.h \
+    mainwindow.h \
+    statsdialog.h
 
 FORMS += \
     mainwindow.ui
@@ -0,0 +1,99 @@
+#include "archivedialog.h"
+#include "eventfiltermodel.h"
+#include "eventmodel.h"
+#include "eventstore.h"
+#include "logarchiver.h"
+#include <QFileInfo>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QSortFilterProxyModel>
+#include <QTableView>
+#include <QThread>
+#include <QTimer>
+#include <QVBoxLayout>
+
+ArchiveDialog::ArchiveDialog(const QString &path, QWidget *parent)
+    : QDialog(parent)
+    , archivePath(path)
+    , store(nullptr)
+    , extracted(false)
+{
+    setWindowTitle("Archivio: " + QFileInfo(archivePath).fileName());
+    resize(800, 500);
+
+    model = new EventModel(this);
+    filterModel = new EventFilterModel(this);
+    filterModel->setSourceModel(model);
+    proxy = new QSortFilterProxyModel(this);
+    proxy->setSourceModel(filterModel);
+    proxy->setSortRole(EventModel::SortRole);
+    proxy->setDynamicSortFilter(false);
+
+    view = new QTableView(this);
+    view->setModel(proxy);
+    view->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
+    view->horizontalHeader()->setSectionResizeMode(EventModel::FileColumn, QHeaderView::Stretch);
+    view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    view->setColumnWidth(EventModel::ColorColumn, 30);
+    view->setColumnWidth(EventModel::EventColumn, 100);
+    view->setColumnWidth(EventModel::TimeColumn, 200);
+    view->setSortingEnabled(true);
+    view->sortByColumn(-1, Qt::AscendingOrder);
+
+    filterEdit = new QLineEdit(this);
+    filterEdit->setPlaceholderText("Filtra per nome (*, ? e [ per un glob)");
+    filterEdit->setEnabled(false);
+    statusLabel = new QLabel("Decompressione in corso...", this);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(filterEdit);
+    layout->addWidget(view);
+    layout->addWidget(statusLabel);
+
+    filterTimer = new QTimer(this);
+    filterTimer->setSingleShot(true);
+    filterTimer->setInterval(150);
+    connect(filterTimer, &QTimer::timeout, this, &ArchiveDialog::applyFilter);
+    connect(filterEdit, &QLineEdit::textChanged, filterTimer, qOverload<>(&QTimer::start));
+
+    // Un segmento puo' essere grande: la finestra resta reattiva
+    QString storeBase = tempDir.path() + "/events";
+    loader = QThread::create([this, storeBase] {
+        extracted = tempDir.isValid() && LogArchiver::extract(archivePath, storeBase);
+    });
+    connect(loader, &QThread::finished, this, &ArchiveDialog::loaded);
+    loader->start();
+}
+
+ArchiveDialog::~ArchiveDialog()
+{
+    loader->wait();
+    delete loader;
+    model->setHistory(nullptr);
+    delete store;
+}
+
+void ArchiveDialog::loaded()
+{
+    store = new EventStore(tempDir.path() + "/events");
+    if (!extracted || !store->open()) {
+        statusLabel->setText("Archivio non leggibile");
+        return;
+    }
+    model->setHistory(store);
+    filterEdit->setEnabled(true);
+    statusLabel->setText(QString("%1 eventi").arg(store->size()));
+}
+
+void ArchiveDialog::applyFilter()
+{
+    EventIndex::Query query;
+    query.pattern = filterEdit->text().trimmed().toStdString();
+    query.glob = query.pattern.find_first_of("*?[") != std::string::npos;
+    filterModel->setQuery(query);
+    statusLabel->setText(query.isEmpty() ? QString("%1 eventi").arg(store->size())
+                                         : QString("%1 eventi trovati in %2 ms")
+                                               .arg(filterModel->rowCount())
+                                               .arg(filterModel->lastQueryTime()));
+}
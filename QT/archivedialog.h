@@ -0,0 +1,48 @@
+#ifndef ARCHIVEDIALOG_H
+#define ARCHIVEDIALOG_H
+
+#include <QDialog>
+#include <QTemporaryDir>
+
+class EventFilterModel;
+class EventModel;
+class EventStore;
+class QLabel;
+class QLineEdit;
+class QSortFilterProxyModel;
+class QTableView;
+class QThread;
+class QTimer;
+
+// Mostra un segmento compresso dello storico, su richiesta: il segmento
+// viene decompresso in un thread in una cartella temporanea e aperto
+// come EventStore, con lo stesso modello e lo stesso filtro della
+// finestra principale. La cartella temporanea sparisce con la finestra.
+class ArchiveDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit ArchiveDialog(const QString &archivePath, QWidget *parent = nullptr);
+    ~ArchiveDialog();
+
+private slots:
+    void loaded();
+    void applyFilter();
+
+private:
+    QString archivePath;
+    QTemporaryDir tempDir;
+    EventStore *store;
+    EventModel *model;
+    EventFilterModel *filterModel;
+    QSortFilterProxyModel *proxy;
+    QTableView *view;
+    QLineEdit *filterEdit;
+    QLabel *statusLabel;
+    QTimer *filterTimer;
+    QThread *loader;
+    bool extracted;
+};
+
+#endif // ARCHIVEDIALOG_H
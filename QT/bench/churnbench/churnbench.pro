@@ -0,0 +1,12 @@
+# Benchmark del rilevamento sotto carico: latenza, eventi/s e CPU per evento
+TEMPLATE = app
+QT -= gui
+CONFIG += console
+CONFIG -= app_bundle
+
+QMAKE_CXXFLAGS_RELEASE += -O2
+
+include(../../monitorcore.pri)
+
+SOURCES += \
+    main.cpp
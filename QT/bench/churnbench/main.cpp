@@ -0,0 +1,271 @@
+// Benchmark del rilevamento con un carico sintetico di modifiche.
+//
+//   churnbench [--files N] [--rate OP/S] [--seconds S] [--quiet MS]
+//              [--threads N] [--hash] [cartella]
+//
+// Un thread crea, modifica e cancella a ritmo costante file scelti a caso
+// tra N (in 16 sottocartelle) di una cartella temporanea, mentre un
+// DirectoryScanner la monitora come nell'applicazione. Per ogni
+// operazione si misura il tempo fino all'arrivo dell'evento del file nel
+// thread principale, cioe' watcher, confronto, accorpamento e consegna a
+// blocchi. Alla fine riporta i percentili della latenza, gli eventi al
+// secondo e il tempo di CPU per evento, escluso quello del generatore.
+// Un'operazione che non produce un evento proprio (per esempio due
+// scritture nello stesso millisecondo) viene contata con l'evento
+// successivo dello stesso file; quelle mai segnalate sono "perse".
+
+#include "directoryscanner.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock Clock;
+
+static const int Subdirs = 16;
+
+static int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static double processCpuSeconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+           + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static double threadCpuSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static std::string fileName(long i)
+{
+    return "d" + std::to_string(i % Subdirs) + "/f" + std::to_string(i);
+}
+
+// Operazioni in attesa del loro evento, per file
+struct Tracker {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::vector<int64_t>> pending;
+    std::vector<double> latencies;      // ms
+    long operations[3] = {0, 0, 0};
+    long events = 0;
+    long spurious = 0;
+
+    void record(const std::string &name, int type)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending[name].push_back(nowNs());
+        ++operations[type];
+    }
+
+    void received(const QList<FileEvent> &batch)
+    {
+        int64_t now = nowNs();
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const FileEvent &event : batch) {
+            ++events;
+            auto found = pending.find(QFile::encodeName(event.fileName).toStdString());
+            if (found == pending.end() || found->second.empty()) {
+                ++spurious;
+                continue;
+            }
+            for (int64_t start : found->second) {
+                latencies.push_back((now - start) / 1e6);
+            }
+            pending.erase(found);
+        }
+    }
+
+    long outstanding()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        long count = 0;
+        for (const auto &entry : pending) {
+            count += long(entry.second.size());
+        }
+        return count;
+    }
+};
+
+// Esegue operazioni a ritmo costante finche' stop non diventa vero
+static void generate(const std::string &root, long files, double rate, std::atomic<bool> *stop,
+                     Tracker *tracker, double *cpuSeconds)
+{
+    double cpuStart = threadCpuSeconds();
+    std::mt19937_64 random(42);
+    std::vector<bool> exists(size_t(files), false);
+    const char data[16] = {'c', 'h', 'u', 'r', 'n', 'b', 'e', 'n', 'c', 'h', '-', 'd', 'a', 't', 'a', '\n'};
+
+    Clock::time_point start = Clock::now();
+    for (long op = 0; !stop->load(); ++op) {
+        std::this_thread::sleep_until(start + std::chrono::nanoseconds(int64_t(op * 1e9 / rate)));
+
+        long i = long(random() % uint64_t(files));
+        std::string name = fileName(i);
+        std::string path = root + "/" + name;
+        if (!exists[size_t(i)]) {
+            tracker->record(name, int(EventType::Created));
+            int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd >= 0) {
+                ssize_t written = write(fd, data, sizeof(data));
+                (void)written;
+                close(fd);
+            }
+            exists[size_t(i)] = true;
+        } else if (random() % 10 < 7) {
+            tracker->record(name, int(EventType::Modified));
+            int fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+            if (fd >= 0) {
+                ssize_t written = write(fd, data, sizeof(data));
+                (void)written;
+                close(fd);
+            }
+        } else {
+            tracker->record(name, int(EventType::Deleted));
+            unlink(path.c_str());
+            exists[size_t(i)] = false;
+        }
+    }
+    *cpuSeconds = threadCpuSeconds() - cpuStart;
+}
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = std::min(sorted.size() - 1, size_t(p / 100.0 * double(sorted.size())));
+    return sorted[index];
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmark del rilevamento con modifiche sintetiche.");
+    parser.addHelpOption();
+    QCommandLineOption filesOption("files", "File coinvolti (1000).", "N", "1000");
+    QCommandLineOption rateOption("rate", "Operazioni al secondo (2000).", "op/s", "2000");
+    QCommandLineOption secondsOption("seconds", "Durata del carico (10).", "s", "10");
+    QCommandLineOption quietOption("quiet", "Finestra di accorpamento, 0 = disattivo (0).", "ms", "0");
+    QCommandLineOption threadsOption("threads", "Thread della scansione, 0 = uno per core (0).", "N", "0");
+    QCommandLineOption hashOption("hash", "Attiva le impronte del contenuto.");
+    parser.addOptions({filesOption, rateOption, secondsOption, quietOption, threadsOption, hashOption});
+    parser.addPositionalArgument("cartella", "Cartella vuota da usare al posto di una temporanea.");
+    parser.process(app);
+
+    long files = qMax(1L, parser.value(filesOption).toLong());
+    double rate = qMax(1.0, parser.value(rateOption).toDouble());
+    int seconds = qMax(1, parser.value(secondsOption).toInt());
+
+    QTemporaryDir temporary;
+    QString root = parser.positionalArguments().isEmpty() ? temporary.path()
+                                                          : parser.positionalArguments().first();
+    QDir dir(root);
+    for (int i = 0; i < Subdirs; ++i) {
+        dir.mkpath("d" + QString::number(i));
+    }
+
+    qRegisterMetaType<FileEvent>();
+    qRegisterMetaType<QList<FileEvent>>();
+    QThread scanThread;
+    DirectoryScanner *scanner = new DirectoryScanner(root);
+    scanner->setCrawlThreads(parser.value(threadsOption).toInt());
+    ContentHasher::Options hashOptions;
+    hashOptions.enabled = parser.isSet(hashOption);
+    scanner->setContentHashing(hashOptions);
+    EventCoalescer::Options coalesceOptions;
+    coalesceOptions.quietMs = parser.value(quietOption).toLongLong();
+    scanner->setCoalescing(coalesceOptions);
+    scanner->moveToThread(&scanThread);
+    QObject::connect(&scanThread, &QThread::started, scanner, &DirectoryScanner::start);
+    QObject::connect(&scanThread, &QThread::finished, scanner, &QObject::deleteLater);
+
+    Tracker tracker;
+    QObject::connect(scanner, &DirectoryScanner::eventsReady, &app,
+                     [&tracker](const QList<FileEvent> &events) { tracker.received(events); });
+    scanThread.start();
+    // Attende la fine della prima scansione
+    QMetaObject::invokeMethod(scanner, [] {}, Qt::BlockingQueuedConnection);
+
+    std::printf("cartella %s, %ld file, %.0f op/s per %d s, accorpamento %lld ms\n",
+                qPrintable(root), files, rate, seconds, coalesceOptions.quietMs);
+
+    std::atomic<bool> stop(false);
+    double generatorCpu = 0;
+    double cpuStart = processCpuSeconds();
+    Clock::time_point wallStart = Clock::now();
+    std::thread generator(generate, QFile::encodeName(root).toStdString(), files, rate, &stop,
+                          &tracker, &generatorCpu);
+
+    // Fine del carico, poi al piu' 5 s per gli eventi ancora in arrivo
+    Clock::time_point drainEnd;
+    QTimer drain;
+    drain.setInterval(50);
+    QObject::connect(&drain, &QTimer::timeout, &app, [&] {
+        if (tracker.outstanding() == 0 || Clock::now() >= drainEnd) {
+            drain.stop();
+            app.quit();
+        }
+    });
+    QTimer::singleShot(seconds * 1000, &app, [&] {
+        stop = true;
+        generator.join();
+        drainEnd = Clock::now() + std::chrono::seconds(5);
+        drain.start();
+    });
+    app.exec();
+
+    QMetaObject::invokeMethod(scanner, &DirectoryScanner::flush, Qt::BlockingQueuedConnection);
+    QCoreApplication::sendPostedEvents(&app, QEvent::MetaCall);
+    double wall = std::chrono::duration<double>(Clock::now() - wallStart).count();
+    double cpu = processCpuSeconds() - cpuStart - generatorCpu;
+    scanThread.quit();
+    scanThread.wait();
+
+    std::lock_guard<std::mutex> lock(tracker.mutex);
+    std::vector<double> sorted = tracker.latencies;
+    std::sort(sorted.begin(), sorted.end());
+    long operations = tracker.operations[0] + tracker.operations[1] + tracker.operations[2];
+    long lost = 0;
+    for (const auto &entry : tracker.pending) {
+        lost += long(entry.second.size());
+    }
+
+    std::printf("operazioni   %ld (create %ld, modificate %ld, cancellate %ld)\n", operations,
+                tracker.operations[0], tracker.operations[1], tracker.operations[2]);
+    std::printf("eventi       %ld (%.0f/s), senza operazione %ld, operazioni perse %ld\n",
+                tracker.events, tracker.events / wall, tracker.spurious, lost);
+    std::printf("latenza ms   p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n",
+                percentile(sorted, 50), percentile(sorted, 90), percentile(sorted, 99),
+                percentile(sorted, 99.9), sorted.empty() ? 0.0 : sorted.back());
+    std::printf("CPU          %.3f s, %.1f us per evento\n", cpu,
+                tracker.events ? cpu * 1e6 / tracker.events : 0.0);
+    return 0;
+}
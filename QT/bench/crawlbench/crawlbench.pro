@@ -0,0 +1,21 @@
+# Benchmark della scansione ricorsiva: usa solo la libreria standard
+TEMPLATE = app
+CONFIG += console c++17 thread
+CONFIG -= app_bundle qt
+
+QMAKE_CXXFLAGS_RELEASE += -O2
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    main.cpp \
+    ../../contenthasher.cpp \
+    ../../filetree.cpp \
+    ../../pathtrie.cpp \
+    ../../workerpool.cpp
+
+HEADERS += \
+    ../../contenthasher.h \
+    ../../filetree.h \
+    ../../pathtrie.h \
+    ../../workerpool.h
@@ -0,0 +1,91 @@
+// Benchmark della scansione ricorsiva di FileTree.
+//
+//   crawlbench [numero di file]   crea un albero sintetico in /tmp e lo scansiona
+//   crawlbench <cartella>         scansiona una cartella esistente
+//
+// Per ogni numero di thread misura la prima scansione (tutti i file
+// nuovi) e una seconda senza modifiche, in file al secondo.
+
+#include "filetree.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock Clock;
+
+// 100 file per cartella, 100 cartelle per livello
+static void generate(const std::string &root, long files)
+{
+    mkdir(root.c_str(), 0755);
+    for (long i = 0; i < files; ++i) {
+        long dir = i / 100;
+        std::string top = root + "/d" + std::to_string(dir / 100);
+        std::string leaf = top + "/d" + std::to_string(dir % 100);
+        if (i % 10000 == 0) {
+            mkdir(top.c_str(), 0755);
+        }
+        if (i % 100 == 0) {
+            mkdir(leaf.c_str(), 0755);
+        }
+        int fd = open((leaf + "/f" + std::to_string(i % 100)).c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+static double crawl(FileTree &tree, size_t *changes)
+{
+    std::vector<FileTree::Change> out;
+    Clock::time_point t0 = Clock::now();
+    tree.crawl(std::string(), out);
+    *changes = out.size();
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+int main(int argc, char *argv[])
+{
+    std::string root;
+    struct stat st;
+    if (argc > 1 && stat(argv[1], &st) == 0 && S_ISDIR(st.st_mode)) {
+        root = argv[1];
+    } else {
+        long files = argc > 1 ? std::strtol(argv[1], nullptr, 10) : 200000;
+        root = "/tmp/crawlbench-" + std::to_string(files);
+        if (stat(root.c_str(), &st) != 0) {
+            std::printf("Creazione di %ld file in %s...\n", files, root.c_str());
+            generate(root, files);
+        }
+    }
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> counts{1};
+    for (unsigned t = 2; t < cores; t *= 2) {
+        counts.push_back(t);
+    }
+    if (cores > 1) {
+        counts.push_back(cores);
+    }
+
+    for (unsigned threads : counts) {
+        FileTree tree(root);
+        tree.setThreads(threads);
+        size_t changes;
+        double first = crawl(tree, &changes);
+        size_t unchanged;
+        double second = crawl(tree, &unchanged);
+        std::printf("%2u thread: %zu file, %zu cartelle, prima scansione %.0f file/s (%.2f s), "
+                    "seconda %.0f file/s (%zu modifiche), memoria %.1f MiB\n",
+                    threads, tree.fileCount(), tree.directoryCount(), tree.fileCount() / first, first,
+                    tree.fileCount() / second, unchanged, tree.memoryUsage() / 1048576.0);
+    }
+    return 0;
+}
@@ -0,0 +1,258 @@
+#include "contenthasher.h"
+#include "workerpool.h"
+#include <algorithm>
+#include <atomic>
+#include <csetjmp>
+#include <csignal>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static const uint64_t Prime1 = 11400714785074694791ull;
+static const uint64_t Prime2 = 14029467366897019727ull;
+static const uint64_t Prime3 = 1609587929392839161ull;
+static const uint64_t Prime4 = 9650029242287828579ull;
+static const uint64_t Prime5 = 2870177450012600261ull;
+
+static inline uint64_t rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char *p)
+{
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char *p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input)
+{
+    acc += input * Prime2;
+    acc = rotl(acc, 31);
+    return acc * Prime1;
+}
+
+static inline uint64_t mergeRound(uint64_t acc, uint64_t val)
+{
+    acc ^= round64(0, val);
+    return acc * Prime1 + Prime4;
+}
+
+static int64_t toNs(const struct timespec &ts)
+{
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// Un file troncato mentre e' mappato provoca SIGBUS alla lettura delle
+// pagine oltre la nuova fine: il thread che sta leggendo torna al punto
+// di salto e il file risulta illeggibile. Negli altri casi il segnale
+// passa al gestore installato prima.
+static thread_local sigjmp_buf *busJump = nullptr;
+static std::once_flag busHandlerInstalled;
+static struct sigaction previousBus;
+
+static void busHandler(int sig, siginfo_t *info, void *context)
+{
+    if (busJump) {
+        siglongjmp(*busJump, 1);
+    }
+    if (previousBus.sa_flags & SA_SIGINFO) {
+        previousBus.sa_sigaction(sig, info, context);
+    } else if (previousBus.sa_handler != SIG_DFL && previousBus.sa_handler != SIG_IGN) {
+        previousBus.sa_handler(sig);
+    } else {
+        // Un SIGBUS ignorato si ripeterebbe all'infinito
+        signal(sig, SIG_DFL);
+        raise(sig);
+    }
+}
+
+static void installBusHandler()
+{
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_sigaction = busHandler;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGBUS, &action, &previousBus);
+}
+
+ContentHasher::ContentHasher()
+    : available(std::chrono::steady_clock::now())
+{
+}
+
+void ContentHasher::setOptions(const Options &options)
+{
+    opts = options;
+}
+
+// XXH64 (little endian)
+uint64_t ContentHasher::hashBytes(const void *data, size_t len, uint64_t seed)
+{
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    const unsigned char *end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+        uint64_t v1 = seed + Prime1 + Prime2;
+        uint64_t v2 = seed + Prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - Prime1;
+        const unsigned char *limit = end - 32;
+        do {
+            v1 = round64(v1, read64(p));
+            v2 = round64(v2, read64(p + 8));
+            v3 = round64(v3, read64(p + 16));
+            v4 = round64(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = seed + Prime5;
+    }
+
+    h += len;
+    for (; p + 8 <= end; p += 8) {
+        h ^= round64(0, read64(p));
+        h = rotl(h, 27) * Prime1 + Prime4;
+    }
+    if (p + 4 <= end) {
+        h ^= uint64_t(read32(p)) * Prime1;
+        h = rotl(h, 23) * Prime2 + Prime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= *p * Prime5;
+        h = rotl(h, 11) * Prime1;
+    }
+
+    h ^= h >> 33;
+    h *= Prime2;
+    h ^= h >> 29;
+    h *= Prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+void ContentHasher::hash(std::vector<Job> &jobs)
+{
+    unsigned threads = opts.threads ? opts.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, jobs.size()));
+
+    std::atomic<size_t> next(0);
+    WorkerPool::global().run(threads, [&] {
+        for (size_t i = next++; i < jobs.size(); i = next++) {
+            hashFile(jobs[i]);
+        }
+    });
+
+    if (opts.bytesPerSecond == 0) {
+        return;
+    }
+    // I byte letti spostano in avanti il momento in cui si potra' leggere
+    // ancora
+    uint64_t bytes = 0;
+    for (const Job &job : jobs) {
+        if (job.ok) {
+            bytes += job.key.size;
+        }
+    }
+    available = std::max(available, std::chrono::steady_clock::now())
+                + std::chrono::nanoseconds(static_cast<int64_t>(double(bytes) * 1e9 / double(opts.bytesPerSecond)));
+}
+
+uint64_t ContentHasher::batchBytes() const
+{
+    if (opts.bytesPerSecond == 0) {
+        return UINT64_MAX;
+    }
+    return std::max<uint64_t>(opts.bytesPerSecond / 10, 1);
+}
+
+int ContentHasher::pauseMs() const
+{
+    if (opts.bytesPerSecond == 0) {
+        return 0;
+    }
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(available - std::chrono::steady_clock::now());
+    return static_cast<int>(std::min<int64_t>(std::max<int64_t>(wait.count(), 0), 3600000));
+}
+
+void ContentHasher::hashFile(Job &job)
+{
+    job.ok = false;
+
+    int fd = open(job.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    // La chiave viene dal descrittore letto, non da una stat precedente
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return;
+    }
+    job.key.inode = st.st_ino;
+    job.key.size = static_cast<uint64_t>(st.st_size);
+#ifdef __APPLE__
+    job.key.mtimeNs = toNs(st.st_mtimespec);
+    job.key.ctimeNs = toNs(st.st_ctimespec);
+#else
+    job.key.mtimeNs = toNs(st.st_mtim);
+    job.key.ctimeNs = toNs(st.st_ctim);
+#endif
+    if (job.key.size > opts.maxFileSize) {
+        close(fd);
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    job.startNs = toNs(now);
+
+    if (job.key.size == 0) {
+        job.hash = hashBytes(nullptr, 0);
+        job.ok = true;
+        close(fd);
+        return;
+    }
+
+    void *data = mmap(nullptr, job.key.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(data, job.key.size, MADV_SEQUENTIAL);
+#endif
+
+    std::call_once(busHandlerInstalled, installBusHandler);
+    sigjmp_buf jump;
+    if (sigsetjmp(jump, 1) == 0) {
+        busJump = &jump;
+        job.hash = hashBytes(data, job.key.size);
+        job.ok = true;
+    }
+    busJump = nullptr;
+    munmap(data, job.key.size);
+}
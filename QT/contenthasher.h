@@ -0,0 +1,73 @@
+#ifndef CONTENTHASHER_H
+#define CONTENTHASHER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Impronta del contenuto dei file per la modalita' a impronte di FileTree.
+// I file vengono mappati in memoria e passati a XXH64, un hash a 64 bit
+// non crittografico, dai thread condivisi di WorkerPool. I file oltre
+// maxFileSize non vengono letti. La lettura complessiva puo' essere
+// limitata a bytesPerSecond: hash() non attende mai, ma conta i byte letti
+// e pauseMs() indica quanto rimandare il lotto successivo, cosi' una
+// raffica di modifiche non satura il disco.
+class ContentHasher
+{
+public:
+    struct Options {
+        bool enabled = false;
+        uint64_t maxFileSize = 256ull << 20;    // byte, oltre si usano solo i metadati
+        uint64_t bytesPerSecond = 0;            // 0 = nessun limite
+        unsigned threads = 0;                   // 0 = un thread per core
+    };
+
+    // Metadati che, se invariati, rendono inutile rileggere il file
+    struct Key {
+        uint64_t inode = 0;
+        uint64_t size = 0;
+        int64_t mtimeNs = 0;
+        int64_t ctimeNs = 0;
+
+        bool operator==(const Key &other) const
+        {
+            return inode == other.inode && size == other.size
+                   && mtimeNs == other.mtimeNs && ctimeNs == other.ctimeNs;
+        }
+        bool operator!=(const Key &other) const { return !(*this == other); }
+    };
+
+    struct Job {
+        std::string path;
+        Key key;            // metadati del file effettivamente letto
+        uint64_t hash = 0;
+        int64_t startNs = 0;    // ora (CLOCK_REALTIME) di inizio lettura
+        bool ok = false;        // false: file sparito, troppo grande o illeggibile
+    };
+
+    ContentHasher();
+
+    void setOptions(const Options &options);
+    const Options &options() const { return opts; }
+
+    // Calcola in parallelo l'impronta di ogni job
+    void hash(std::vector<Job> &jobs);
+    // Millisecondi da attendere prima di altre letture per restare entro
+    // bytesPerSecond, 0 se si puo' procedere
+    int pauseMs() const;
+    // Byte da leggere al piu' in un lotto: un decimo di secondo secondo
+    // bytesPerSecond, senza limite se non e' impostato
+    uint64_t batchBytes() const;
+
+    static uint64_t hashBytes(const void *data, size_t len, uint64_t seed = 0);
+
+private:
+    Options opts;
+    std::chrono::steady_clock::time_point available;
+
+    void hashFile(Job &job);
+};
+
+#endif // CONTENTHASHER_H
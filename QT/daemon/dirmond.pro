@@ -0,0 +1,17 @@
+# Demone senza interfaccia: monitora una cartella e scrive gli eventi
+# su un file o sullo standard output
+TEMPLATE = app
+TARGET = dirmond
+QT -= gui
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../monitorcore.pri)
+
+SOURCES += \
+    main.cpp
+
+DESTDIR = ../build
+
+unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
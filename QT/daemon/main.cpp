@@ -0,0 +1,163 @@
+// Demone di DirectoryMonitor senza interfaccia grafica.
+//
+//   dirmond [-o <file>] [cartella...]
+//   dirmond [-o <file>] --archive <segmento.gz>
+//
+// Monitora le cartelle come l'applicazione (stesse impostazioni, stesso
+// journal e stesso storico per ogni cartella) e scrive ogni evento su una
+// riga:
+//   <ora ISO 8601>\t<Created|Modified|Deleted>\t<percorso>
+// Con una sola cartella il percorso e' relativo a essa, con piu'
+// cartelle e' preceduto dalla cartella. Senza cartelle sulla riga di
+// comando si usa l'array "roots" delle impostazioni, dove ogni radice
+// puo' avere priority e pollInterval. Tutte le cartelle condividono un
+// thread e uno scheduler delle scansioni.
+// Senza -o, o con -o -, le righe vanno sullo standard output.
+// Con --archive scrive nello stesso formato gli eventi di un segmento
+// compresso dello storico ed esce.
+// SIGINT e SIGTERM chiudono il demone consegnando gli eventi in attesa.
+// Con metrics/port nelle impostazioni le metriche della pipeline sono su
+// http://127.0.0.1:<port>/metrics, con metrics/dumpFile anche in un file.
+
+#include "eventstore.h"
+#include "logarchiver.h"
+#include "monitorsession.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <cstdio>
+
+#ifdef Q_OS_UNIX
+#include <QSocketNotifier>
+#include <csignal>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Il gestore del segnale scrive solo un byte: la chiusura avviene nel
+// ciclo degli eventi, dove e' lecito chiamare Qt
+static int signalFds[2] = {-1, -1};
+
+static void onSignal(int)
+{
+    char byte = 1;
+    ssize_t written = ::write(signalFds[0], &byte, 1);
+    Q_UNUSED(written);
+}
+
+static void installSignalHandlers(QCoreApplication &app)
+{
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, signalFds) != 0) {
+        return;
+    }
+    QSocketNotifier *notifier = new QSocketNotifier(signalFds[1], QSocketNotifier::Read, &app);
+    QObject::connect(notifier, &QSocketNotifier::activated, &app, [notifier] {
+        char byte;
+        ssize_t got = ::read(signalFds[1], &byte, 1);
+        Q_UNUSED(got);
+        notifier->setEnabled(false);
+        QCoreApplication::quit();
+    });
+
+    struct sigaction action;
+    action.sa_handler = onSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    // Stesse impostazioni dell'applicazione grafica
+    QCoreApplication::setOrganizationName("DirectoryMonitor");
+    QCoreApplication::setApplicationName("DirectoryMonitor");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Monitora una o piu' cartelle e scrive gli eventi dei file.");
+    parser.addHelpOption();
+    QCommandLineOption outputOption(QStringList() << "o" << "output",
+                                    "Scrive gli eventi su <file> (- = standard output).", "file", "-");
+    parser.addOption(outputOption);
+    QCommandLineOption archiveOption("archive", "Scrive gli eventi del segmento compresso <file> ed esce.", "file");
+    parser.addOption(archiveOption);
+    parser.addPositionalArgument("cartella", "Cartelle da monitorare.", "[cartella...]");
+    parser.process(app);
+
+    QFile output;
+    QString outputPath = parser.value(outputOption);
+    bool opened;
+    if (outputPath == "-") {
+        opened = output.open(stdout, QIODevice::WriteOnly);
+    } else {
+        output.setFileName(outputPath);
+        opened = output.open(QIODevice::WriteOnly | QIODevice::Append);
+    }
+    if (!opened) {
+        std::fprintf(stderr, "dirmond: impossibile aprire %s\n", qPrintable(outputPath));
+        return 1;
+    }
+
+    if (parser.isSet(archiveOption)) {
+        QTemporaryDir tempDir;
+        EventStore store(tempDir.path() + "/events");
+        if (!tempDir.isValid() || !LogArchiver::extract(parser.value(archiveOption), tempDir.path() + "/events")
+            || !store.open()) {
+            std::fprintf(stderr, "dirmond: segmento non leggibile %s\n", qPrintable(parser.value(archiveOption)));
+            return 1;
+        }
+        for (qint64 row = 0; row < store.size(); ++row) {
+            output.write(QDateTime::fromMSecsSinceEpoch(store.time(row)).toString(Qt::ISODateWithMs).toUtf8() + '\t'
+                         + eventName(store.eventType(row)).toUtf8() + '\t'
+                         + store.name(store.nameId(row)).toUtf8() + '\n');
+        }
+        return 0;
+    }
+
+    QSettings settings;
+    QStringList dirs = parser.positionalArguments();
+    QVector<MonitorSession::RootOptions> rootOptions(dirs.size());
+    if (dirs.isEmpty()) {
+        MonitorSession::readRoots(settings, &dirs, &rootOptions);
+    }
+    if (dirs.isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    MonitorSession session;
+    for (int i = 0; i < dirs.size(); ++i) {
+        QDir dir(dirs[i]);
+        if (!dir.exists()) {
+            std::fprintf(stderr, "dirmond: %s non e' una cartella\n", qPrintable(dirs[i]));
+            return 1;
+        }
+        session.addRoot(dir.canonicalPath(), rootOptions[i]);
+    }
+
+#ifdef Q_OS_UNIX
+    installSignalHandlers(app);
+#endif
+
+    bool prefixed = session.rootCount() > 1;
+    QObject::connect(&session, &MonitorSession::eventsAdded,
+                     [&output, &session, prefixed](int root, const QList<FileEvent> &events) {
+        QByteArray prefix = prefixed ? (session.directory(root) + "/").toUtf8() : QByteArray();
+        QByteArray lines;
+        for (const FileEvent &event : events) {
+            lines += event.time.toString(Qt::ISODateWithMs).toUtf8() + '\t'
+                     + eventName(event.type).toUtf8() + '\t'
+                     + prefix + event.fileName.toUtf8() + '\n';
+        }
+        // Un blocco alla volta, subito visibile a chi legge la pipe
+        output.write(lines);
+        output.flush();
+    });
+
+    session.start(settings);
+    return app.exec();
+}
@@ -0,0 +1,423 @@
+#include "directoryscanner.h"
+#include "directorywatcher.h"
+#include "metrics.h"
+#include "scanscheduler.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTimer>
+
+static Histogram &crawlDuration = Metrics::global().histogram(
+    "dirmon_crawl_duration_us", "Durata di una rilettura di un sottoalbero, in microsecondi");
+static Histogram &crawlEntries = Metrics::global().histogram(
+    "dirmon_crawl_entries", "Voci lette con stat da una rilettura");
+static Histogram &checkDuration = Metrics::global().histogram(
+    "dirmon_check_files_duration_us", "Durata del controllo dei file segnalati da inotify, in microsecondi");
+static Histogram &changesDetected = Metrics::global().histogram(
+    "dirmon_changes_per_check", "Modifiche trovate da una rilettura o da un controllo");
+static Counter &statTotal = Metrics::global().counter(
+    "dirmon_stat_total", "Voci lette con stat da tutte le riletture e i controlli");
+static Counter &skippedTotal = Metrics::global().counter(
+    "dirmon_dirs_skipped_total", "Cartelle non rilette dal polling perche' invariate");
+
+static std::string localPath(const QString &path)
+{
+    return QFile::encodeName(path).toStdString();
+}
+
+DirectoryScanner::DirectoryScanner(const QString &dir, QObject *parent)
+    : QObject(parent)
+    , monitoredDir(dir)
+    , tree(localPath(dir))
+    , watcher(nullptr)
+    , scheduler(nullptr)
+    , pollTimer(nullptr)
+    , batchTimer(nullptr)
+    , hashTimer(nullptr)
+    , coalesceTimer(nullptr)
+    , pollInterval(-1)
+    , eventDriven(false)
+    , watchesExhausted(false)
+    , slowScanMs(1000)
+    , lastEntries(0)
+    , fullScanEvery(10)
+    , pollsSinceFull(0)
+    , batchInterval(16)
+    , maxBatch(2000)
+{
+}
+
+void DirectoryScanner::setLoggedFiles(const QSet<QString> &files)
+{
+    loggedFiles = files;
+}
+
+void DirectoryScanner::setPollInterval(int ms)
+{
+    pollInterval = ms;
+}
+
+void DirectoryScanner::setBatching(int intervalMs, int maxEvents)
+{
+    batchInterval = intervalMs;
+    maxBatch = qMax(1, maxEvents);
+}
+
+void DirectoryScanner::setCrawlThreads(int threads)
+{
+    tree.setThreads(static_cast<unsigned>(qMax(0, threads)));
+}
+
+void DirectoryScanner::setContentHashing(const ContentHasher::Options &options)
+{
+    tree.setContentHashing(options);
+}
+
+void DirectoryScanner::setCoalescing(const EventCoalescer::Options &options)
+{
+    coalescer.setOptions(options);
+}
+
+void DirectoryScanner::setSlowScanWarning(int ms)
+{
+    slowScanMs = ms;
+}
+
+void DirectoryScanner::setFullScanEvery(int polls)
+{
+    fullScanEvery = polls;
+}
+
+void DirectoryScanner::setScheduler(ScanScheduler *owner)
+{
+    scheduler = owner;
+}
+
+qint64 DirectoryScanner::lastCrawlEntries() const
+{
+    return lastEntries;
+}
+
+// Eseguito nel thread di lavoro: watcher e timer appartengono a quel thread
+void DirectoryScanner::start()
+{
+    batchTimer = new QTimer(this);
+    batchTimer->setSingleShot(true);
+    batchTimer->setInterval(batchInterval);
+    connect(batchTimer, &QTimer::timeout, this, &DirectoryScanner::deliver);
+
+    watcher = new DirectoryWatcher(this);
+    connect(watcher, &DirectoryWatcher::filesChanged, this, &DirectoryScanner::checkFiles);
+    connect(watcher, &DirectoryWatcher::directoryChanged, this, &DirectoryScanner::checkSubtree);
+    connect(watcher, &DirectoryWatcher::rescanNeeded, this, &DirectoryScanner::rescan);
+    watcher->watch(monitoredDir);
+
+    pollTimer = new QTimer(this);
+    connect(pollTimer, &QTimer::timeout, this, &DirectoryScanner::checkDirectory);
+
+    // Le impronte iniziali si calcolano a piccoli blocchi, tra un
+    // evento e l'altro
+    hashTimer = new QTimer(this);
+    hashTimer->setInterval(0);
+    connect(hashTimer, &QTimer::timeout, this, &DirectoryScanner::hashPending);
+
+    coalesceTimer = new QTimer(this);
+    coalesceTimer->setSingleShot(true);
+    connect(coalesceTimer, &QTimer::timeout, this, &DirectoryScanner::releaseCoalesced);
+
+    // Prima scansione completa, poi solo gli eventi
+    crawl(std::string());
+    apply();
+    // Con inotify il polling resta solo come rete di sicurezza;
+    // followWatcher() lo imposta se inotify copre l'albero
+    updateWatches();
+    if (pollInterval >= 0 || !eventDriven) {
+        schedulePolling(pollInterval >= 0 ? pollInterval : 3000);
+    }
+}
+
+void DirectoryScanner::schedulePolling(int ms)
+{
+    if (scheduler) {
+        scheduler->setInterval(this, ms);
+    } else if (ms > 0) {
+        pollTimer->start(ms);
+    } else {
+        pollTimer->stop();
+    }
+}
+
+// Rilettura misurata; le riletture lente finiscono nel log con il
+// percorso, per trovare le cartelle patologiche
+void DirectoryScanner::crawl(const std::string &relativePath, FileTree::CrawlMode mode)
+{
+    QElapsedTimer timer;
+    timer.start();
+    uint64_t statsBefore = tree.statCount();
+    uint64_t skippedBefore = tree.skippedCount();
+    tree.crawl(relativePath, changes, mode);
+    qint64 elapsed = timer.nsecsElapsed() / 1000;
+    uint64_t entries = tree.statCount() - statsBefore;
+    lastEntries = qint64(entries);
+
+    crawlDuration.record(uint64_t(elapsed));
+    crawlEntries.record(entries);
+    changesDetected.record(changes.size());
+    statTotal.add(entries);
+    skippedTotal.add(tree.skippedCount() - skippedBefore);
+    if (slowScanMs > 0 && elapsed >= qint64(slowScanMs) * 1000) {
+        QString path = monitoredDir;
+        if (!relativePath.empty()) {
+            path += "/" + QFile::decodeName(QByteArray::fromStdString(relativePath));
+        }
+        qWarning() << "DirectoryScanner: rilettura lenta di" << path
+                   << elapsed / 1000 << "ms," << entries << "voci";
+    }
+}
+
+// Con inotify le modifiche ai file arrivano come eventi e quelle alle
+// cartelle cambiano la loro data: il polling basta che guardi le date
+// delle cartelle, senza una stat per file. Le cancellazioni escono dal
+// confronto dell'elenco con i figli noti.
+void DirectoryScanner::checkDirectory()
+{
+    // Un watch perso da una sottocartella (IN_IGNORED) non passa da
+    // updateWatches(): la copertura si controlla prima di ogni polling
+    followWatcher();
+    bool full = !eventDriven || (fullScanEvery > 0 && ++pollsSinceFull >= fullScanEvery);
+    if (full) {
+        pollsSinceFull = 0;
+    }
+    crawl(std::string(), full ? FileTree::FullCrawl : FileTree::SkipUnchanged);
+    apply();
+    updateWatches();
+}
+
+void DirectoryScanner::rescan()
+{
+    pollsSinceFull = 0;
+    crawl(std::string());
+    apply();
+    updateWatches();
+}
+
+void DirectoryScanner::checkSubtree(const QString &relativePath)
+{
+    crawl(localPath(relativePath));
+    apply();
+    // Una cartella appena creata puo' essersi riempita prima che il suo
+    // watch fosse attivo: la si rilegge una volta con il watch in piedi
+    int added = 0;
+    if (updateWatches(&added) && added > 0) {
+        crawl(localPath(relativePath));
+        apply();
+        updateWatches();
+    }
+}
+
+void DirectoryScanner::checkFiles(const QStringList &fileNames)
+{
+    std::vector<std::string> paths;
+    paths.reserve(fileNames.size());
+    for (const QString &fileName : fileNames) {
+        paths.push_back(localPath(fileName));
+    }
+    QElapsedTimer timer;
+    timer.start();
+    uint64_t statsBefore = tree.statCount();
+    tree.checkFiles(paths, changes);
+    checkDuration.record(uint64_t(timer.nsecsElapsed() / 1000));
+    changesDetected.record(changes.size());
+    statTotal.add(tree.statCount() - statsBefore);
+    apply();
+}
+
+// Il limite di lettura si rispetta rimandando il lotto successivo, senza
+// fermare il thread che riceve gli eventi. I file modificati in attesa
+// passano prima delle impronte iniziali.
+void DirectoryScanner::hashPending()
+{
+    if (tree.pendingSuspects() > 0) {
+        tree.checkSuspects(changes);
+        changesDetected.record(changes.size());
+        apply();
+    } else {
+        tree.hashPending(64);
+    }
+    if (tree.pendingHashes() == 0) {
+        hashTimer->stop();
+    } else {
+        hashTimer->start(tree.hashPause());
+    }
+}
+
+// Passa le differenze trovate da FileTree all'accorpamento e segnala
+// quelle con la finestra chiusa
+void DirectoryScanner::apply()
+{
+    if (coalescer.options().quietMs > 0) {
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
+        coalescer.add(changes, now);
+        changes.clear();
+        coalescer.take(now, changes);
+
+        qint64 due = coalescer.nextDue();
+        if (due >= 0) {
+            coalesceTimer->start(int(qBound<qint64>(0, due - now, coalescer.options().maxDelayMs)));
+        } else {
+            coalesceTimer->stop();
+        }
+    }
+    reportChanges();
+
+    if (tree.pendingHashes() > 0 && !hashTimer->isActive()) {
+        hashTimer->start(tree.hashPause());
+    }
+}
+
+void DirectoryScanner::releaseCoalesced()
+{
+    apply();
+}
+
+void DirectoryScanner::flush()
+{
+    if (!batchTimer) {
+        // Lo scheduler non ha ancora avviato lo scanner
+        return;
+    }
+    coalesceTimer->stop();
+    coalescer.takeAll(changes);
+    reportChanges();
+
+    batchTimer->stop();
+    while (!pending.isEmpty()) {
+        deliver();
+    }
+    batchTimer->stop();
+}
+
+// Converte le differenze in eventi
+void DirectoryScanner::reportChanges()
+{
+    for (const FileTree::Change &change : changes) {
+        QString fileName = QFile::decodeName(QByteArray::fromStdString(tree.path(change.node)));
+        if (fileName == "log.txt") {
+            continue;
+        }
+        switch (change.type) {
+        case FileTree::Created:
+            // File gia' presente nello storico: lo seguiamo da qui
+            // senza segnalarlo di nuovo come creato
+            if (!loggedFiles.contains(fileName)) {
+                report(fileName, EventType::Created, QDateTime::fromMSecsSinceEpoch(change.mtime));
+            }
+            break;
+        case FileTree::Modified:
+            report(fileName, EventType::Modified, QDateTime::fromMSecsSinceEpoch(change.mtime));
+            break;
+        case FileTree::Deleted:
+            // Dopo l'accorpamento mtime e' l'ora in cui e' stata vista
+            report(fileName, EventType::Deleted,
+                   change.mtime ? QDateTime::fromMSecsSinceEpoch(change.mtime) : QDateTime::currentDateTime());
+            break;
+        }
+    }
+    changes.clear();
+}
+
+// Allinea i watch di inotify alle cartelle note; restituisce false se
+// qualche cartella e' rimasta senza watch
+bool DirectoryScanner::updateWatches(int *addedCount)
+{
+    // La radice rimossa o spostata puo' essere tornata al suo posto
+    if (!watcher->reportsFiles()) {
+        watcher->rearm();
+    }
+    std::vector<std::string> added;
+    std::vector<std::string> removed;
+    tree.takeDirectoryChanges(added, removed);
+
+    for (const std::string &dir : removed) {
+        watcher->removeDirectory(QFile::decodeName(QByteArray::fromStdString(dir)));
+    }
+
+    bool complete = true;
+    for (const std::string &dir : added) {
+        if (!watcher->addDirectory(QFile::decodeName(QByteArray::fromStdString(dir)))) {
+            complete = false;
+        }
+    }
+    // Watch persi: si rimettono su tutte le cartelle note, per quelle che
+    // li hanno gia' inotify restituisce lo stesso descrittore
+    if (complete && !watchesExhausted && watcher->reportsFiles()
+        && size_t(watcher->watchCount()) != tree.directoryCount()) {
+        std::vector<std::string> known;
+        tree.directoryPaths(known);
+        for (const std::string &dir : known) {
+            if (!watcher->addDirectory(QFile::decodeName(QByteArray::fromStdString(dir)))) {
+                complete = false;
+            }
+        }
+    }
+    if (!complete && !watchesExhausted) {
+        // Limite dei watch esaurito (fs.inotify.max_user_watches):
+        // le cartelle senza watch vengono controllate dal polling
+        watchesExhausted = true;
+        if (watcher->reportsFiles() && pollInterval < 0) {
+            qWarning() << "DirectoryScanner: watch inotify esauriti, si torna al polling";
+        }
+    }
+    followWatcher();
+    if (addedCount) {
+        *addedCount = static_cast<int>(added.size());
+    }
+    return complete;
+}
+
+// Il polling segue lo stato di inotify: rete di sicurezza finche' ogni
+// cartella nota ha il suo watch, unica fonte affidabile quando non e'
+// cosi'. Solo con la copertura completa il polling salta le cartelle
+// invariate.
+void DirectoryScanner::followWatcher()
+{
+    bool live = watcher->reportsFiles() && size_t(watcher->watchCount()) == tree.directoryCount();
+    if (live == eventDriven) {
+        return;
+    }
+    eventDriven = live;
+    if (!live) {
+        qWarning() << "DirectoryScanner: inotify non segue piu'" << monitoredDir << "- si torna al polling";
+    }
+    if (pollInterval < 0) {
+        schedulePolling(live ? 60000 : 3000);
+    }
+}
+
+void DirectoryScanner::report(const QString &fileName, EventType type, const QDateTime &time)
+{
+    // Un file cancellato torna a poter essere segnalato come creato
+    if (type == EventType::Deleted) {
+        loggedFiles.remove(fileName);
+    } else {
+        loggedFiles.insert(fileName);
+    }
+
+    pending.append(FileEvent{fileName, type, time});
+    if (!batchTimer->isActive()) {
+        batchTimer->start();
+    }
+}
+
+void DirectoryScanner::deliver()
+{
+    if (pending.size() <= maxBatch) {
+        emit eventsReady(pending);
+        pending.clear();
+        return;
+    }
+    // Blocco troppo grande: il resto parte al prossimo intervallo
+    emit eventsReady(pending.mid(0, maxBatch));
+    pending.remove(0, maxBatch);
+    batchTimer->start();
+}
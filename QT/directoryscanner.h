@@ -0,0 +1,109 @@
+#ifndef DIRECTORYSCANNER_H
+#define DIRECTORYSCANNER_H
+
+#include "eventcoalescer.h"
+#include "fileevent.h"
+#include "filetree.h"
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+
+class DirectoryWatcher;
+class ScanScheduler;
+class QTimer;
+
+// Rileva le modifiche dell'albero monitorato in un thread di lavoro.
+// Lo stato noto e' un FileTree: la prima scansione e le riletture
+// complete lo percorrono con piu' thread, gli eventi di inotify toccano
+// solo i file e le cartelle interessate. Gli eventi vengono consegnati
+// a blocchi tramite eventsReady(): al piu' un blocco ogni batchInterval
+// ms e al piu' maxBatch eventi per blocco, cosi' la GUI non resta mai
+// bloccata anche se la scansione e' lenta. I nomi dei file sono
+// percorsi relativi alla cartella monitorata.
+class DirectoryScanner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DirectoryScanner(const QString &dir, QObject *parent = nullptr);
+
+    // Da chiamare prima di start()
+    void setLoggedFiles(const QSet<QString> &files);
+    // Intervallo del polling di sicurezza in ms: 0 lo disattiva,
+    // negativo sceglie in base al backend di notifica
+    void setPollInterval(int ms);
+    void setBatching(int intervalMs, int maxEvents);
+    // Thread usati per percorrere l'albero, 0 = uno per core
+    void setCrawlThreads(int threads);
+    // Modalita' a impronte: Modified solo se cambia il contenuto
+    void setContentHashing(const ContentHasher::Options &options);
+    // Finestre di accorpamento degli eventi di uno stesso file
+    void setCoalescing(const EventCoalescer::Options &options);
+    // Riletture oltre ms finiscono nel log, 0 = mai
+    void setSlowScanWarning(int ms);
+    // Con inotify attivo su tutte le cartelle il polling salta le
+    // cartelle invariate; un polling ogni n le rilegge comunque tutte,
+    // 0 = mai, 1 = sempre
+    void setFullScanEvery(int polls);
+    // Con uno scheduler il polling e la prima scansione li decide lui;
+    // lo imposta ScanScheduler::addScanner()
+    void setScheduler(ScanScheduler *scheduler);
+
+    // Voci lette (stat) dall'ultima rilettura: con le cartelle invariate
+    // saltate sono molte meno dei file noti
+    qint64 lastCrawlEntries() const;
+
+public slots:
+    void start();
+    void checkDirectory();
+    // Rilettura completa, per quando inotify ha perso eventi
+    void rescan();
+    void checkSubtree(const QString &relativePath);
+    void checkFiles(const QStringList &fileNames);
+    // Consegna subito tutto cio' che e' in attesa, anche se la finestra
+    // di accorpamento non e' chiusa
+    void flush();
+
+signals:
+    void eventsReady(const QList<FileEvent> &events);
+
+private slots:
+    void deliver();
+    void hashPending();
+    void releaseCoalesced();
+
+private:
+    QString monitoredDir;
+    FileTree tree;
+    // File presenti nello storico; aggiornato a ogni evento
+    QSet<QString> loggedFiles;
+
+    DirectoryWatcher *watcher;
+    ScanScheduler *scheduler;
+    QTimer *pollTimer;
+    QTimer *batchTimer;
+    QTimer *hashTimer;
+    QTimer *coalesceTimer;
+    int pollInterval;
+    bool eventDriven;
+    bool watchesExhausted;
+    int slowScanMs;
+    qint64 lastEntries;
+    int fullScanEvery;
+    int pollsSinceFull;
+    int batchInterval;
+    int maxBatch;
+    QList<FileEvent> pending;
+    std::vector<FileTree::Change> changes;
+    EventCoalescer coalescer;
+
+    void crawl(const std::string &relativePath, FileTree::CrawlMode mode = FileTree::FullCrawl);
+    void apply();
+    void reportChanges();
+    bool updateWatches(int *addedCount = nullptr);
+    void followWatcher();
+    void schedulePolling(int ms);
+    void report(const QString &fileName, EventType type, const QDateTime &time);
+};
+
+#endif // DIRECTORYSCANNER_H
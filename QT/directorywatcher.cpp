@@ -0,0 +1,226 @@
+#include "directorywatcher.h"
+#include <QFile>
+#include <QFileSystemWatcher>
+#include <QSocketNotifier>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+
+static const uint32_t watchMask = IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB
+                                  | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                                  | IN_DELETE_SELF | IN_MOVE_SELF;
+#endif
+
+DirectoryWatcher::DirectoryWatcher(QObject *parent)
+    : QObject(parent)
+    , inotifyFd(-1)
+    , watchDescriptor(-1)
+    , notifier(nullptr)
+    , fallback(nullptr)
+{
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+    unwatch();
+}
+
+bool DirectoryWatcher::watch(const QString &path)
+{
+    unwatch();
+    dirPath = path;
+
+#ifdef Q_OS_LINUX
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd >= 0) {
+        watchDescriptor = inotify_add_watch(inotifyFd, QFile::encodeName(path).constData(), watchMask);
+        if (watchDescriptor >= 0) {
+            watchPaths.insert(watchDescriptor, QString());
+            notifier = new QSocketNotifier(inotifyFd, QSocketNotifier::Read, this);
+            connect(notifier, &QSocketNotifier::activated, this, &DirectoryWatcher::readEvents);
+            return true;
+        }
+        ::close(inotifyFd);
+        inotifyFd = -1;
+    }
+#endif
+
+    // QFileSystemWatcher non segnala le modifiche al contenuto dei file
+    // della cartella: in questo caso il polling resta necessario
+    fallback = new QFileSystemWatcher(this);
+    if (fallback->addPath(path)) {
+        connect(fallback, &QFileSystemWatcher::directoryChanged, this, &DirectoryWatcher::rescanNeeded);
+        return true;
+    }
+    delete fallback;
+    fallback = nullptr;
+    return false;
+}
+
+void DirectoryWatcher::unwatch()
+{
+    delete notifier;
+    notifier = nullptr;
+    delete fallback;
+    fallback = nullptr;
+#ifdef Q_OS_LINUX
+    if (inotifyFd >= 0) {
+        ::close(inotifyFd);
+    }
+#endif
+    inotifyFd = -1;
+    watchDescriptor = -1;
+    watchPaths.clear();
+    pathWatches.clear();
+}
+
+bool DirectoryWatcher::addDirectory(const QString &relativePath)
+{
+#ifdef Q_OS_LINUX
+    if (inotifyFd < 0) {
+        return false;
+    }
+    QString path = dirPath + "/" + relativePath;
+    int wd = inotify_add_watch(inotifyFd, QFile::encodeName(path).constData(), watchMask | IN_ONLYDIR);
+    if (wd < 0) {
+        // ENOENT: cartella gia' sparita, la rilettura del padre lo rileva
+        return errno == ENOENT;
+    }
+    // Una cartella spostata nell'albero mantiene il suo watch: si
+    // aggiorna solo il percorso
+    auto old = watchPaths.find(wd);
+    if (old != watchPaths.end()) {
+        pathWatches.remove(old.value());
+    }
+    watchPaths.insert(wd, relativePath);
+    pathWatches.insert(relativePath, wd);
+    return true;
+#else
+    Q_UNUSED(relativePath);
+    return false;
+#endif
+}
+
+void DirectoryWatcher::removeDirectory(const QString &relativePath)
+{
+#ifdef Q_OS_LINUX
+    auto it = pathWatches.find(relativePath);
+    if (it == pathWatches.end()) {
+        return;
+    }
+    inotify_rm_watch(inotifyFd, it.value());
+    watchPaths.remove(it.value());
+    pathWatches.erase(it);
+#else
+    Q_UNUSED(relativePath);
+#endif
+}
+
+bool DirectoryWatcher::reportsFiles() const
+{
+    return inotifyFd >= 0 && watchDescriptor >= 0;
+}
+
+int DirectoryWatcher::watchCount() const
+{
+    return watchPaths.size();
+}
+
+bool DirectoryWatcher::rearm()
+{
+#ifdef Q_OS_LINUX
+    if (inotifyFd < 0) {
+        return false;
+    }
+    if (watchDescriptor >= 0) {
+        return true;
+    }
+    watchDescriptor = inotify_add_watch(inotifyFd, QFile::encodeName(dirPath).constData(), watchMask | IN_ONLYDIR);
+    if (watchDescriptor < 0) {
+        return false;
+    }
+    watchPaths.insert(watchDescriptor, QString());
+    return true;
+#else
+    return false;
+#endif
+}
+
+void DirectoryWatcher::readEvents()
+{
+#ifdef Q_OS_LINUX
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    QStringList changed;
+    QStringList dirs;
+    bool lost = false;
+
+    for (;;) {
+        ssize_t len = ::read(inotifyFd, buffer, sizeof(buffer));
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (len <= 0) {
+            break; // EAGAIN: coda svuotata
+        }
+        for (char *p = buffer; p < buffer + len;) {
+            const struct inotify_event *ev = reinterpret_cast<const struct inotify_event *>(p);
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                lost = true;
+                continue;
+            }
+            auto dir = watchPaths.constFind(ev->wd);
+            if (dir == watchPaths.constEnd()) {
+                continue;
+            }
+            if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                // Per le sottocartelle basta l'evento nella cartella padre
+                if (ev->wd == watchDescriptor) {
+                    // Dopo uno spostamento il watch seguirebbe la cartella
+                    // nella nuova posizione: lo si toglie comunque
+                    inotify_rm_watch(inotifyFd, ev->wd);
+                    watchPaths.remove(ev->wd);
+                    watchDescriptor = -1;
+                    lost = true;
+                } else if (ev->mask & IN_IGNORED) {
+                    if (pathWatches.value(dir.value(), -1) == ev->wd) {
+                        pathWatches.remove(dir.value());
+                    }
+                    watchPaths.remove(ev->wd);
+                }
+                continue;
+            }
+            if (ev->len == 0) {
+                continue;
+            }
+            QString name = QFile::decodeName(ev->name);
+            QString path = dir.value().isEmpty() ? name : dir.value() + "/" + name;
+            if (!(ev->mask & IN_ISDIR)) {
+                changed << path;
+            } else if (ev->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)) {
+                dirs << path;
+            }
+        }
+    }
+
+    if (lost) {
+        // Se al suo posto c'e' di nuovo una cartella la si torna a seguire
+        if (watchDescriptor < 0) {
+            rearm();
+        }
+        emit rescanNeeded();
+        return;
+    }
+    dirs.removeDuplicates();
+    for (const QString &dir : dirs) {
+        emit directoryChanged(dir);
+    }
+    if (!changed.isEmpty()) {
+        changed.removeDuplicates();
+        emit filesChanged(changed);
+    }
+#endif
+}
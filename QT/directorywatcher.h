@@ -0,0 +1,65 @@
+#ifndef DIRECTORYWATCHER_H
+#define DIRECTORYWATCHER_H
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+class QSocketNotifier;
+class QFileSystemWatcher;
+
+// Notifica le modifiche di un albero di cartelle senza polling.
+// Su Linux usa direttamente inotify, con un watch per ogni cartella
+// aggiunta con addDirectory(), e riporta i percorsi relativi dei file
+// toccati; altrove ricade su QFileSystemWatcher sulla sola radice, che
+// segnala solo che la cartella e' cambiata e richiede una nuova scansione.
+class DirectoryWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DirectoryWatcher(QObject *parent = nullptr);
+    ~DirectoryWatcher();
+
+    bool watch(const QString &path);
+    void unwatch();
+
+    // Sottocartelle, con percorso relativo alla radice; false se il
+    // backend non lo permette o il limite dei watch e' esaurito
+    bool addDirectory(const QString &relativePath);
+    void removeDirectory(const QString &relativePath);
+
+    // true se il backend riporta i singoli file (inotify) e la radice
+    // ha un watch attivo
+    bool reportsFiles() const;
+    // Rimette il watch della radice dopo che e' stata rimossa o spostata;
+    // false se la cartella non c'e' o il backend non e' inotify
+    bool rearm();
+    // Watch attivi, radice compresa
+    int watchCount() const;
+
+signals:
+    // Percorsi relativi alla radice
+    void filesChanged(const QStringList &fileNames);
+    // Sottocartella creata, cancellata o spostata: va riletta
+    void directoryChanged(const QString &relativePath);
+    // Eventi persi (coda inotify piena) o radice rimossa/spostata: serve
+    // una scansione completa; senza la radice reportsFiles() e' false
+    // finche' rearm() non riesce
+    void rescanNeeded();
+
+private slots:
+    void readEvents();
+
+private:
+    QString dirPath;
+    int inotifyFd;
+    int watchDescriptor;
+    QHash<int, QString> watchPaths;
+    QHash<QString, int> pathWatches;
+    QSocketNotifier *notifier;
+    QFileSystemWatcher *fallback;
+};
+
+#endif // DIRECTORYWATCHER_H
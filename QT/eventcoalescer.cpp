@@ -0,0 +1,112 @@
+#include "eventcoalescer.h"
+#include <algorithm>
+
+EventCoalescer::EventCoalescer()
+    : in(0)
+    , out(0)
+{
+}
+
+void EventCoalescer::setOptions(const Options &options)
+{
+    opts = options;
+}
+
+void EventCoalescer::add(const FileTree::Change &change, int64_t nowMs)
+{
+    ++in;
+    bool exists = change.type != FileTree::Deleted;
+    int64_t mtime = exists ? change.mtime : nowMs;
+
+    auto it = states.find(change.node);
+    if (it == states.end()) {
+        State state;
+        state.existedBefore = change.type != FileTree::Created;
+        state.existsNow = exists;
+        state.first = nowMs;
+        state.due = nowMs + opts.quietMs;
+        state.mtime = mtime;
+        states.emplace(change.node, state);
+        deadlines.push(Deadline{state.due, change.node});
+        return;
+    }
+
+    // Ogni nuova modifica sposta la scadenza, ma non oltre maxDelayMs
+    State &state = it->second;
+    state.existsNow = exists;
+    state.mtime = mtime;
+    int64_t due = std::min(nowMs + opts.quietMs, state.first + opts.maxDelayMs);
+    if (due != state.due) {
+        state.due = due;
+        deadlines.push(Deadline{due, change.node});
+    }
+}
+
+void EventCoalescer::add(const std::vector<FileTree::Change> &changes, int64_t nowMs)
+{
+    for (const FileTree::Change &change : changes) {
+        add(change, nowMs);
+    }
+}
+
+bool EventCoalescer::emit(uint32_t node, const State &state, std::vector<FileTree::Change> &result)
+{
+    FileTree::ChangeType type;
+    if (!state.existedBefore && state.existsNow) {
+        type = FileTree::Created;
+    } else if (state.existedBefore && state.existsNow) {
+        type = FileTree::Modified;
+    } else if (state.existedBefore) {
+        type = FileTree::Deleted;
+    } else {
+        // Creato e cancellato nella stessa finestra
+        return false;
+    }
+    result.push_back(FileTree::Change{node, type, state.mtime});
+    ++out;
+    return true;
+}
+
+void EventCoalescer::take(int64_t nowMs, std::vector<FileTree::Change> &result)
+{
+    while (!deadlines.empty() && deadlines.top().due <= nowMs) {
+        Deadline d = deadlines.top();
+        deadlines.pop();
+        // Le scadenze superate da una modifica successiva restano nella
+        // coda: si riconoscono perche' non corrispondono piu' allo stato
+        auto it = states.find(d.node);
+        if (it == states.end() || it->second.due != d.due) {
+            continue;
+        }
+        emit(d.node, it->second, result);
+        states.erase(it);
+    }
+}
+
+void EventCoalescer::takeAll(std::vector<FileTree::Change> &result)
+{
+    // In ordine di scadenza, come take()
+    while (!deadlines.empty()) {
+        Deadline d = deadlines.top();
+        deadlines.pop();
+        auto it = states.find(d.node);
+        if (it == states.end() || it->second.due != d.due) {
+            continue;
+        }
+        emit(d.node, it->second, result);
+        states.erase(it);
+    }
+}
+
+int64_t EventCoalescer::nextDue()
+{
+    while (!deadlines.empty()) {
+        const Deadline &d = deadlines.top();
+        auto it = states.find(d.node);
+        if (it != states.end() && it->second.due == d.due) {
+            return d.due;
+        }
+        deadlines.pop();
+    }
+    return -1;
+}
@@ -0,0 +1,68 @@
+#ifndef EVENTCOALESCER_H
+#define EVENTCOALESCER_H
+
+#include "filetree.h"
+#include <cstdint>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+// Accorpa le modifiche di FileTree prima che diventino eventi.
+// Le modifiche di uno stesso file restano in attesa finche' il file non
+// resta fermo per quietMs, o al piu' per maxDelayMs dalla prima. In uscita
+// conta solo se il file esisteva prima della finestra e se esiste alla
+// fine: Created, Modified, Modified diventa un solo Created, una coppia
+// Created, Deleted sparisce e Deleted, Created diventa Modified.
+class EventCoalescer
+{
+public:
+    struct Options {
+        int64_t quietMs = 300;      // 0 = nessun accorpamento
+        int64_t maxDelayMs = 2000;
+    };
+
+    EventCoalescer();
+
+    void setOptions(const Options &options);
+    const Options &options() const { return opts; }
+
+    // nowMs in millisecondi dall'epoch; diventa la data delle cancellazioni
+    void add(const FileTree::Change &change, int64_t nowMs);
+    void add(const std::vector<FileTree::Change> &changes, int64_t nowMs);
+
+    // Sposta in out le modifiche la cui finestra e' chiusa
+    void take(int64_t nowMs, std::vector<FileTree::Change> &out);
+    void takeAll(std::vector<FileTree::Change> &out);
+
+    // Scadenza piu' vicina, -1 se non c'e' nulla in attesa
+    int64_t nextDue();
+    size_t pending() const { return states.size(); }
+
+    uint64_t received() const { return in; }
+    uint64_t emitted() const { return out; }
+
+private:
+    struct State {
+        bool existedBefore;
+        bool existsNow;
+        int64_t first;
+        int64_t due;
+        int64_t mtime;
+    };
+
+    struct Deadline {
+        int64_t due;
+        uint32_t node;
+        bool operator>(const Deadline &other) const { return due > other.due; }
+    };
+
+    Options opts;
+    std::unordered_map<uint32_t, State> states;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines;
+    uint64_t in;
+    uint64_t out;
+
+    bool emit(uint32_t node, const State &state, std::vector<FileTree::Change> &result);
+};
+
+#endif // EVENTCOALESCER_H
@@ -0,0 +1,280 @@
+#include "eventfiltermodel.h"
+#include "eventmodel.h"
+#include "eventstore.h"
+#include <QElapsedTimer>
+#include <algorithm>
+
+// EventIndex riduce in minuscolo solo l'ASCII: nomi e pattern gli
+// arrivano gia' normalizzati, cosi' la ricerca ignora le maiuscole anche
+// per le lettere accentate e gli altri alfabeti
+static std::string foldCase(const QString &text)
+{
+    return text.toCaseFolded().toStdString();
+}
+
+EventFilterModel::EventFilterModel(QObject *parent)
+    : QAbstractProxyModel(parent)
+    , events(nullptr)
+    , filtering(false)
+    , indexed(false)
+    , indexBase(0)
+    , removeFirst(0)
+    , removeCount(0)
+    , queryTime(0)
+{
+}
+
+void EventFilterModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    beginResetModel();
+    if (events) {
+        disconnect(events, nullptr, this, nullptr);
+    }
+    events = qobject_cast<EventModel *>(sourceModel);
+    QAbstractProxyModel::setSourceModel(events);
+    if (events) {
+        connect(events, &QAbstractItemModel::rowsAboutToBeInserted, this, &EventFilterModel::sourceRowsAboutToBeInserted);
+        connect(events, &QAbstractItemModel::rowsInserted, this, &EventFilterModel::sourceRowsInserted);
+        connect(events, &QAbstractItemModel::rowsAboutToBeRemoved, this, &EventFilterModel::sourceRowsAboutToBeRemoved);
+        connect(events, &QAbstractItemModel::rowsRemoved, this, &EventFilterModel::sourceRowsRemoved);
+        connect(events, &QAbstractItemModel::modelAboutToBeReset, this, &EventFilterModel::sourceAboutToBeReset);
+        connect(events, &QAbstractItemModel::modelReset, this, &EventFilterModel::sourceReset);
+    }
+    indexed = false;
+    eventIndex.clear();
+    rows.clear();
+    if (filtering) {
+        runQuery();
+    }
+    endResetModel();
+}
+
+void EventFilterModel::setQuery(const EventIndex::Query &query)
+{
+    beginResetModel();
+    filtering = !query.isEmpty();
+    EventIndex::Query folded = query;
+    folded.pattern = foldCase(QString::fromStdString(query.pattern));
+    filter = eventIndex.compile(folded);
+    rows.clear();
+    queryTime = 0;
+    if (filtering) {
+        runQuery();
+    }
+    endResetModel();
+}
+
+const EventIndex::Query &EventFilterModel::query() const
+{
+    return filter.query();
+}
+
+qint64 EventFilterModel::lastQueryTime() const
+{
+    return queryTime;
+}
+
+void EventFilterModel::runQuery()
+{
+    if (!events) {
+        return;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    if (!indexed) {
+        buildIndex();
+    }
+    rows = eventIndex.find(filter);
+    // Le righe gia' uscite dal modello restano nell'indice: si saltano
+    qint64 skip = events->firstSequence() - indexBase;
+    if (skip > 0) {
+        rows.erase(rows.begin(), std::lower_bound(rows.begin(), rows.end(), uint32_t(skip)));
+    }
+    queryTime = timer.elapsed();
+}
+
+// Lo storico si legge dall'archivio mappato: i nomi vengono convertiti
+// una volta per id e non una volta per riga
+void EventFilterModel::buildIndex()
+{
+    eventIndex.clear();
+    indexBase = events->firstSequence();
+    historyNames.clear();
+    const EventStore *store = events->historyStore();
+    int historyRows = events->historyRows();
+    if (store && historyRows > 0) {
+        historyNames.fill(0xffffffffu, int(store->nameCount()));
+        for (int row = 0; row < historyRows; ++row) {
+            qint64 record = indexBase + row;
+            quint32 storeId = store->nameId(record);
+            quint32 &id = historyNames[int(storeId)];
+            if (id == 0xffffffffu) {
+                id = eventIndex.addName(foldCase(store->name(storeId)));
+            }
+            eventIndex.append(id, unsigned(store->eventType(record)), store->time(record));
+        }
+    }
+    indexed = true;
+    indexRows(historyRows, events->rowCount() - 1);
+}
+
+void EventFilterModel::indexRows(int first, int last)
+{
+    for (int row = first; row <= last; ++row) {
+        uint32_t id = eventIndex.addName(foldCase(events->fileName(row)));
+        eventIndex.append(id, unsigned(events->eventType(row)), events->time(row));
+    }
+}
+
+int EventFilterModel::sourceRow(int row) const
+{
+    return int(indexBase + qint64(rows[size_t(row)]) - events->firstSequence());
+}
+
+QModelIndex EventFilterModel::mapToSource(const QModelIndex &proxyIndex) const
+{
+    if (!events || !proxyIndex.isValid()) {
+        return QModelIndex();
+    }
+    int row = filtering ? sourceRow(proxyIndex.row()) : proxyIndex.row();
+    return events->index(row, proxyIndex.column());
+}
+
+QModelIndex EventFilterModel::mapFromSource(const QModelIndex &sourceIndex) const
+{
+    if (!events || !sourceIndex.isValid()) {
+        return QModelIndex();
+    }
+    if (!filtering) {
+        return index(sourceIndex.row(), sourceIndex.column());
+    }
+    uint32_t row = uint32_t(events->firstSequence() + sourceIndex.row() - indexBase);
+    auto found = std::lower_bound(rows.begin(), rows.end(), row);
+    if (found == rows.end() || *found != row) {
+        return QModelIndex();
+    }
+    return index(int(found - rows.begin()), sourceIndex.column());
+}
+
+QModelIndex EventFilterModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (parent.isValid() || row < 0 || row >= rowCount() || column < 0 || column >= columnCount()) {
+        return QModelIndex();
+    }
+    return createIndex(row, column);
+}
+
+QModelIndex EventFilterModel::parent(const QModelIndex &child) const
+{
+    Q_UNUSED(child);
+    return QModelIndex();
+}
+
+int EventFilterModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() || !events) {
+        return 0;
+    }
+    return filtering ? int(rows.size()) : events->rowCount();
+}
+
+int EventFilterModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() || !events) {
+        return 0;
+    }
+    return events->columnCount();
+}
+
+// Le intestazioni non dipendono dalle righe: anche con zero risultati
+QVariant EventFilterModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (!events || orientation == Qt::Vertical) {
+        return QAbstractProxyModel::headerData(section, orientation, role);
+    }
+    return events->headerData(section, orientation, role);
+}
+
+void EventFilterModel::sourceRowsAboutToBeInserted(const QModelIndex &parent, int first, int last)
+{
+    if (!filtering) {
+        beginInsertRows(parent, first, last);
+    }
+}
+
+// EventModel inserisce solo in coda: le righe accettate si accodano
+void EventFilterModel::sourceRowsInserted(const QModelIndex &parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    if (indexed) {
+        indexRows(first, last);
+    }
+    if (!filtering) {
+        endInsertRows();
+        return;
+    }
+
+    std::vector<uint32_t> accepted;
+    uint32_t base = uint32_t(events->firstSequence() - indexBase);
+    for (int row = first; row <= last; ++row) {
+        if (eventIndex.accepts(filter, base + uint32_t(row))) {
+            accepted.push_back(base + uint32_t(row));
+        }
+    }
+    if (accepted.empty()) {
+        return;
+    }
+    int start = int(rows.size());
+    beginInsertRows(QModelIndex(), start, start + int(accepted.size()) - 1);
+    rows.insert(rows.end(), accepted.begin(), accepted.end());
+    endInsertRows();
+}
+
+void EventFilterModel::sourceRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last)
+{
+    if (!filtering) {
+        beginRemoveRows(parent, first, last);
+        return;
+    }
+    uint32_t base = uint32_t(events->firstSequence() - indexBase);
+    auto from = std::lower_bound(rows.begin(), rows.end(), base + uint32_t(first));
+    auto to = std::upper_bound(from, rows.end(), base + uint32_t(last));
+    removeFirst = int(from - rows.begin());
+    removeCount = int(to - from);
+    if (removeCount > 0) {
+        beginRemoveRows(QModelIndex(), removeFirst, removeFirst + removeCount - 1);
+    }
+}
+
+void EventFilterModel::sourceRowsRemoved(const QModelIndex &parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    Q_UNUSED(first);
+    Q_UNUSED(last);
+    if (!filtering) {
+        endRemoveRows();
+        return;
+    }
+    if (removeCount > 0) {
+        rows.erase(rows.begin() + removeFirst, rows.begin() + removeFirst + removeCount);
+        removeCount = 0;
+        endRemoveRows();
+    }
+}
+
+void EventFilterModel::sourceAboutToBeReset()
+{
+    beginResetModel();
+}
+
+void EventFilterModel::sourceReset()
+{
+    // Storico o capacita' cambiati: l'indice si ricostruisce
+    indexed = false;
+    eventIndex.clear();
+    rows.clear();
+    if (filtering) {
+        runQuery();
+    }
+    endResetModel();
+}
@@ -0,0 +1,67 @@
+#ifndef EVENTFILTERMODEL_H
+#define EVENTFILTERMODEL_H
+
+#include "eventindex.h"
+#include <QAbstractProxyModel>
+#include <QVector>
+
+class EventModel;
+
+// Filtro sopra EventModel che usa un EventIndex invece di chiamare
+// filterAcceptsRow() su ogni riga. L'indice viene costruito alla prima
+// query, leggendo lo storico direttamente dall'archivio, e poi esteso
+// con le righe che arrivano; le righe nuove che soddisfano la query
+// compaiono in coda man mano. Senza query il modello e' trasparente.
+class EventFilterModel : public QAbstractProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit EventFilterModel(QObject *parent = nullptr);
+
+    // Il modello sorgente deve essere un EventModel
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+
+    void setQuery(const EventIndex::Query &query);
+    const EventIndex::Query &query() const;
+    // Durata in ms dell'ultima query, compresa l'eventuale indicizzazione
+    qint64 lastQueryTime() const;
+
+    QModelIndex mapToSource(const QModelIndex &proxyIndex) const override;
+    QModelIndex mapFromSource(const QModelIndex &sourceIndex) const override;
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private slots:
+    void sourceRowsAboutToBeInserted(const QModelIndex &parent, int first, int last);
+    void sourceRowsInserted(const QModelIndex &parent, int first, int last);
+    void sourceRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
+    void sourceRowsRemoved(const QModelIndex &parent, int first, int last);
+    void sourceAboutToBeReset();
+    void sourceReset();
+
+private:
+    EventModel *events;
+    EventIndex eventIndex;
+    EventIndex::Filter filter;
+    bool filtering;
+    bool indexed;
+    qint64 indexBase;           // sequenza della riga 0 dell'indice
+    QVector<quint32> historyNames;
+    // Righe dell'indice accettate, crescenti
+    std::vector<uint32_t> rows;
+    // Righe del filtro tra sourceRowsAboutToBeRemoved() e sourceRowsRemoved()
+    int removeFirst;
+    int removeCount;
+    qint64 queryTime;
+
+    void buildIndex();
+    void indexRows(int first, int last);
+    void runQuery();
+    int sourceRow(int row) const;
+};
+
+#endif // EVENTFILTERMODEL_H
@@ -0,0 +1,394 @@
+#include "eventindex.h"
+#include "workerpool.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+static std::string lower(const std::string &text)
+{
+    std::string result(text);
+    for (char &c : result) {
+        if (c >= 'A' && c <= 'Z') {
+            c = char(c - 'A' + 'a');
+        }
+    }
+    return result;
+}
+
+static uint32_t trigram(const char *p)
+{
+    return (uint32_t(uint8_t(p[0])) << 16) | (uint32_t(uint8_t(p[1])) << 8) | uint32_t(uint8_t(p[2]));
+}
+
+// Tratti letterali del pattern, dove si possono cercare trigrammi
+static std::vector<std::string> literals(const std::string &pattern, bool glob)
+{
+    std::vector<std::string> runs;
+    if (!glob) {
+        runs.push_back(pattern);
+        return runs;
+    }
+    std::string run;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        char c = pattern[i];
+        if (c == '*' || c == '?' || c == '[') {
+            if (c == '[') {
+                size_t close = pattern.find(']', i + 2);
+                if (close == std::string::npos) {
+                    run += c;
+                    continue;
+                }
+                i = close;
+            }
+            runs.push_back(run);
+            run.clear();
+        } else {
+            run += c;
+        }
+    }
+    runs.push_back(run);
+    return runs;
+}
+
+// Confronta un carattere con ?, una classe [...] o un letterale;
+// in next la posizione successiva del pattern
+static bool matchOne(const char *p, char c, const char **next)
+{
+    if (*p == '?') {
+        *next = p + 1;
+        return true;
+    }
+    if (*p == '[') {
+        const char *q = p + 1;
+        bool negate = *q == '!' || *q == '^';
+        if (negate) {
+            ++q;
+        }
+        // La prima ']' dopo l'apertura fa parte della classe; un pattern
+        // che finisce con '[' o '[!' non ha classe da leggere
+        const char *close = *q ? q + 1 : q;
+        while (*close && *close != ']') {
+            ++close;
+        }
+        if (*q && *close) {
+            bool found = false;
+            for (const char *r = q; r < close; ++r) {
+                if (r + 2 < close && r[1] == '-') {
+                    found = found || (uint8_t(c) >= uint8_t(r[0]) && uint8_t(c) <= uint8_t(r[2]));
+                    r += 2;
+                } else {
+                    found = found || c == *r;
+                }
+            }
+            *next = close + 1;
+            return found != negate;
+        }
+        // '[' senza chiusura: letterale
+    }
+    *next = p + 1;
+    return *p == c;
+}
+
+EventIndex::EventIndex()
+{
+}
+
+bool EventIndex::globMatch(const char *pattern, const char *text)
+{
+    const char *p = pattern;
+    const char *t = text;
+    const char *star = nullptr;
+    const char *mark = nullptr;
+    while (*t) {
+        const char *next;
+        if (*p == '*') {
+            star = ++p;
+            mark = t;
+        } else if (*p && matchOne(p, *t, &next)) {
+            p = next;
+            ++t;
+        } else if (star) {
+            // L'ultimo * assorbe un carattere in piu'
+            p = star;
+            t = ++mark;
+        } else {
+            return false;
+        }
+    }
+    while (*p == '*') {
+        ++p;
+    }
+    return *p == '\0';
+}
+
+uint32_t EventIndex::addName(const std::string &name)
+{
+    auto found = nameIds.find(name);
+    if (found != nameIds.end()) {
+        return found->second;
+    }
+    uint32_t id = uint32_t(names.size());
+    nameIds.emplace(name, id);
+    names.push_back(lower(name));
+    postings.emplace_back();
+
+    const std::string &key = names.back();
+    std::vector<uint32_t> grams;
+    for (size_t i = 0; i + 3 <= key.size(); ++i) {
+        grams.push_back(trigram(key.data() + i));
+    }
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    for (uint32_t gram : grams) {
+        trigrams[gram].push_back(id);
+    }
+    return id;
+}
+
+void EventIndex::append(uint32_t nameId, unsigned type, int64_t msecs)
+{
+    uint32_t row = uint32_t(rowNames.size());
+    rowNames.push_back(nameId);
+    rowStamps.push_back((uint64_t(type) << TypeShift) | (uint64_t(msecs) & TimeMask));
+    postings[nameId].push_back(row);
+
+    if (byTime.empty() || time(byTime.back()) <= msecs) {
+        byTime.push_back(row);
+    } else {
+        unsorted.push_back(row);
+        if (unsorted.size() > MaxUnsorted) {
+            sortUnsorted();
+        }
+    }
+}
+
+void EventIndex::clear()
+{
+    rowNames.clear();
+    rowStamps.clear();
+    names.clear();
+    nameIds.clear();
+    postings.clear();
+    trigrams.clear();
+    byTime.clear();
+    unsorted.clear();
+}
+
+void EventIndex::sortUnsorted()
+{
+    auto earlier = [this](uint32_t a, uint32_t b) {
+        return time(a) < time(b) || (time(a) == time(b) && a < b);
+    };
+    std::sort(unsorted.begin(), unsorted.end(), earlier);
+    size_t middle = byTime.size();
+    byTime.insert(byTime.end(), unsorted.begin(), unsorted.end());
+    std::inplace_merge(byTime.begin(), byTime.begin() + std::ptrdiff_t(middle), byTime.end(), earlier);
+    unsorted.clear();
+}
+
+EventIndex::Filter EventIndex::compile(const Query &query) const
+{
+    Filter filter;
+    filter.q = query;
+    filter.pattern = lower(query.pattern);
+    return filter;
+}
+
+bool EventIndex::nameMatches(const Filter &filter, uint32_t nameId) const
+{
+    const std::string &name = names[nameId];
+    if (filter.q.glob) {
+        return globMatch(filter.pattern.c_str(), name.c_str());
+    }
+    return name.find(filter.pattern) != std::string::npos;
+}
+
+// Nomi che contengono tutti i trigrammi dei tratti letterali del pattern
+std::vector<uint32_t> EventIndex::candidateNames(const Filter &filter) const
+{
+    std::vector<uint32_t> keys;
+    for (const std::string &run : literals(filter.pattern, filter.q.glob)) {
+        for (size_t i = 0; i + 3 <= run.size(); ++i) {
+            keys.push_back(trigram(run.data() + i));
+        }
+    }
+    std::vector<uint32_t> result;
+    if (keys.empty()) {
+        result.resize(names.size());
+        for (uint32_t id = 0; id < result.size(); ++id) {
+            result[id] = id;
+        }
+        return result;
+    }
+
+    std::vector<const std::vector<uint32_t> *> lists;
+    for (uint32_t key : keys) {
+        auto found = trigrams.find(key);
+        if (found == trigrams.end()) {
+            return result;
+        }
+        lists.push_back(&found->second);
+    }
+    std::sort(lists.begin(), lists.end(), [](const std::vector<uint32_t> *a, const std::vector<uint32_t> *b) {
+        return a->size() < b->size();
+    });
+    result = *lists.front();
+    std::vector<uint32_t> next;
+    for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+        if (lists[i] == lists[i - 1]) {
+            continue;
+        }
+        next.clear();
+        std::set_intersection(result.begin(), result.end(), lists[i]->begin(), lists[i]->end(),
+                              std::back_inserter(next));
+        result.swap(next);
+    }
+    return result;
+}
+
+bool EventIndex::accepts(Filter &filter, uint32_t row) const
+{
+    const Query &q = filter.q;
+    int64_t t = time(row);
+    if (!(typeBit(row) & q.types) || t < q.from || t > q.to) {
+        return false;
+    }
+    if (filter.pattern.empty()) {
+        return true;
+    }
+    uint32_t id = rowNames[row];
+    if (id >= filter.names.size()) {
+        filter.names.resize(names.size(), 0);
+    }
+    if (filter.names[id] == 0) {
+        filter.names[id] = nameMatches(filter, id) ? 2 : 1;
+    }
+    return filter.names[id] == 2;
+}
+
+// Scorre tutte le righe, a blocchi contigui su piu' thread
+void EventIndex::scan(const Filter &filter, std::vector<uint32_t> &result) const
+{
+    const Query &q = filter.q;
+    bool byName = !filter.pattern.empty();
+    const uint8_t *nameState = filter.names.data();
+    // Senza salti: la riga viene sempre scritta e il contatore avanza
+    // solo se passa il filtro
+    auto check = [&](uint32_t first, uint32_t last, std::vector<uint32_t> &out) {
+        size_t offset = out.size();
+        out.resize(offset + (last - first));
+        uint32_t *dst = out.data() + offset;
+        size_t count = 0;
+        for (uint32_t row = first; row < last; ++row) {
+            uint64_t stamp = rowStamps[row];
+            int64_t t = int64_t(stamp & TimeMask);
+            bool ok = ((1u << (stamp >> TypeShift)) & q.types) != 0;
+            ok &= t >= q.from;
+            ok &= t <= q.to;
+            if (byName) {
+                ok &= nameState[rowNames[row]] == 2;
+            }
+            dst[count] = row;
+            count += ok;
+        }
+        out.resize(offset + count);
+    };
+
+    uint32_t n = uint32_t(size());
+    unsigned threads = std::min(std::max(1u, std::thread::hardware_concurrency()), 8u);
+    threads = std::min<unsigned>(threads, n / (1u << 20) + 1);
+    if (threads <= 1) {
+        check(0, n, result);
+        return;
+    }
+
+    std::vector<std::vector<uint32_t>> parts(threads);
+    uint32_t chunk = (n + threads - 1) / threads;
+    std::atomic<unsigned> next(0);
+    WorkerPool::global().run(threads, [&] {
+        for (unsigned i = next++; i < threads; i = next++) {
+            check(i * chunk, std::min(n, (i + 1) * chunk), parts[i]);
+        }
+    });
+    for (const std::vector<uint32_t> &part : parts) {
+        result.insert(result.end(), part.begin(), part.end());
+    }
+}
+
+std::vector<uint32_t> EventIndex::find(Filter &filter) const
+{
+    const Query &q = filter.q;
+    std::vector<uint32_t> result;
+    size_t n = size();
+    // Oltre questa soglia ordinare i candidati costa piu' che scorrere tutto
+    size_t limit = n / 32;
+
+    size_t nameRows = n;
+    std::vector<uint32_t> matched;
+    if (!filter.pattern.empty()) {
+        filter.names.assign(names.size(), 1);
+        nameRows = 0;
+        for (uint32_t id : candidateNames(filter)) {
+            if (nameMatches(filter, id)) {
+                filter.names[id] = 2;
+                matched.push_back(id);
+                nameRows += postings[id].size();
+            }
+        }
+    }
+
+    size_t rangeRows = n;
+    std::vector<uint32_t>::const_iterator first = byTime.begin();
+    std::vector<uint32_t>::const_iterator last = byTime.end();
+    if (q.from != INT64_MIN || q.to != INT64_MAX) {
+        first = std::lower_bound(byTime.begin(), byTime.end(), q.from,
+                                 [this](uint32_t row, int64_t t) { return time(row) < t; });
+        last = std::upper_bound(first, byTime.cend(), q.to,
+                                [this](int64_t t, uint32_t row) { return t < time(row); });
+        rangeRows = size_t(last - first) + unsorted.size();
+    }
+
+    if (nameRows <= limit && nameRows <= rangeRows) {
+        for (uint32_t id : matched) {
+            for (uint32_t row : postings[id]) {
+                if (accepts(filter, row)) {
+                    result.push_back(row);
+                }
+            }
+        }
+        if (matched.size() > 1) {
+            std::sort(result.begin(), result.end());
+        }
+    } else if (rangeRows <= limit) {
+        for (auto it = first; it != last; ++it) {
+            if (accepts(filter, *it)) {
+                result.push_back(*it);
+            }
+        }
+        for (uint32_t row : unsorted) {
+            if (accepts(filter, row)) {
+                result.push_back(row);
+            }
+        }
+        std::sort(result.begin(), result.end());
+    } else {
+        scan(filter, result);
+    }
+    return result;
+}
+
+size_t EventIndex::memoryUsage() const
+{
+    size_t bytes = rowNames.capacity() * sizeof(uint32_t) + rowStamps.capacity() * sizeof(uint64_t)
+                   + (byTime.capacity() + unsorted.capacity()) * sizeof(uint32_t);
+    for (const std::string &name : names) {
+        bytes += sizeof(std::string) + name.capacity();
+    }
+    for (const std::vector<uint32_t> &list : postings) {
+        bytes += sizeof(list) + list.capacity() * sizeof(uint32_t);
+    }
+    for (const auto &entry : trigrams) {
+        bytes += sizeof(entry) + entry.second.capacity() * sizeof(uint32_t);
+    }
+    return bytes + nameIds.size() * (sizeof(std::string) + sizeof(uint32_t) + 16);
+}
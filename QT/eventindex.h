@@ -0,0 +1,105 @@
+#ifndef EVENTINDEX_H
+#define EVENTINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Indici per la ricerca negli eventi: nome (sottostringa o glob, senza
+// distinzione tra maiuscole e minuscole), tipo e intervallo di tempo.
+// I nomi sono UTF-8 ma qui si riducono in minuscolo solo le lettere
+// ASCII: per le altre nomi e pattern vanno normalizzati da chi li passa,
+// come fa EventFilterModel con QString::toCaseFolded().
+// Le righe sono numerate in ordine di arrivo. Per ogni nome c'e' la
+// lista delle sue righe e per ogni trigramma dei nomi la lista dei nomi
+// che lo contengono; un indice per data permette di leggere solo le
+// righe di un intervallo. Una query parte dall'insieme di candidati piu'
+// piccolo; se tutti sono grandi scorre le colonne delle righe con i
+// thread di WorkerPool, che costa meno che ordinare milioni di candidati.
+class EventIndex
+{
+public:
+    enum TypeBit {
+        CreatedBit = 1,
+        ModifiedBit = 2,
+        DeletedBit = 4,
+        AllTypes = 7
+    };
+
+    struct Query {
+        std::string pattern;    // vuoto = tutti i nomi
+        bool glob = false;      // *, ? e [...] sull'intero percorso
+        unsigned types = AllTypes;
+        int64_t from = INT64_MIN;   // ms dall'epoch, estremi inclusi
+        int64_t to = INT64_MAX;
+
+        bool isEmpty() const
+        {
+            return pattern.empty() && (types & AllTypes) == AllTypes && from == INT64_MIN && to == INT64_MAX;
+        }
+    };
+
+    // Query compilata; ricorda quali nomi corrispondono, cosi' le righe
+    // arrivate dopo si controllano senza rifare il confronto del nome
+    class Filter
+    {
+    public:
+        const Query &query() const { return q; }
+
+    private:
+        friend class EventIndex;
+        Query q;
+        std::string pattern;            // in minuscolo
+        std::vector<uint8_t> names;     // per nome: 0 da calcolare, 1 no, 2 si'
+    };
+
+    EventIndex();
+
+    // Restituisce l'id del nome, aggiungendolo se nuovo
+    uint32_t addName(const std::string &name);
+    // type e' il valore di EventType (0 Created, 1 Modified, 2 Deleted)
+    void append(uint32_t nameId, unsigned type, int64_t msecs);
+    void clear();
+
+    size_t size() const { return rowNames.size(); }
+    size_t nameCount() const { return names.size(); }
+
+    Filter compile(const Query &query) const;
+    // Righe che soddisfano la query, in ordine crescente
+    std::vector<uint32_t> find(Filter &filter) const;
+    bool accepts(Filter &filter, uint32_t row) const;
+
+    static bool globMatch(const char *pattern, const char *text);
+    size_t memoryUsage() const;
+
+private:
+    static constexpr int TypeShift = 62;
+    static constexpr uint64_t TimeMask = (uint64_t(1) << TypeShift) - 1;
+    // Righe fuori ordine accodate prima di riordinare l'indice per data
+    static constexpr size_t MaxUnsorted = 65536;
+
+    // Colonne delle righe: id del nome, tipo nei 2 bit alti e ms
+    std::vector<uint32_t> rowNames;
+    std::vector<uint64_t> rowStamps;
+
+    std::vector<std::string> names;     // in minuscolo
+    std::unordered_map<std::string, uint32_t> nameIds;
+    std::vector<std::vector<uint32_t>> postings;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> trigrams;
+
+    // Righe ordinate per data, piu' una coda di righe fuori ordine
+    std::vector<uint32_t> byTime;
+    std::vector<uint32_t> unsorted;
+
+    int64_t time(uint32_t row) const { return int64_t(rowStamps[row] & TimeMask); }
+    unsigned typeBit(uint32_t row) const { return 1u << (rowStamps[row] >> TypeShift); }
+
+    void sortUnsorted();
+    bool nameMatches(const Filter &filter, uint32_t nameId) const;
+    std::vector<uint32_t> candidateNames(const Filter &filter) const;
+    void scan(const Filter &filter, std::vector<uint32_t> &result) const;
+};
+
+#endif // EVENTINDEX_H
@@ -0,0 +1,318 @@
+#include "eventmodel.h"
+#include "eventstore.h"
+#include "metrics.h"
+#include <QColor>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <climits>
+#include <QTimer>
+
+// Comprende il lavoro dei proxy e della vista collegati, che reagiscono
+// a endInsertRows() in modo sincrono
+static Histogram &insertDuration = Metrics::global().histogram(
+    "dirmon_table_insert_us", "Durata dell'inserimento di un blocco di righe nella tabella, in microsecondi");
+static Histogram &insertRows = Metrics::global().histogram(
+    "dirmon_table_insert_rows", "Righe inserite nella tabella per blocco");
+
+EventModel::EventModel(QObject *parent)
+    : QAbstractTableModel(parent)
+    , history(nullptr)
+    , historyFirst(0)
+    , historyCount(0)
+    , head(0)
+    , count(0)
+    , maxRows(0)
+    , evicted(0)
+{
+    // Gli eventi arrivati nello stesso giro dell'event loop (o entro
+    // pochi ms) vengono inseriti con un solo beginInsertRows
+    flushTimer = new QTimer(this);
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(30);
+    connect(flushTimer, &QTimer::timeout, this, &EventModel::flushPending);
+}
+
+void EventModel::setCapacity(int rows)
+{
+    flushPending();
+    beginResetModel();
+    QVector<quint32> newNames;
+    QVector<quint64> newStamps;
+    int first = (rows > 0 && count > rows) ? count - rows : 0;
+    for (int row = first; row < count; ++row) {
+        newNames.append(nameColumn[physical(row)]);
+        newStamps.append(stampColumn[physical(row)]);
+    }
+    nameColumn.swap(newNames);
+    stampColumn.swap(newStamps);
+    evicted += first;
+    count = nameColumn.size();
+    head = 0;
+    maxRows = rows;
+    compactNames();
+    trimHistory();
+    endResetModel();
+}
+
+void EventModel::setHistory(const EventStore *store)
+{
+    flushPending();
+    beginResetModel();
+    history = store;
+    historyCount = store ? int(qMin<qint64>(store->size(), INT_MAX - count)) : 0;
+    historyFirst = store ? store->size() - historyCount : 0;
+    trimHistory();
+    endResetModel();
+}
+
+// Con una capacita' lo storico mostrato si limita alle righe piu' recenti
+void EventModel::trimHistory()
+{
+    if (maxRows > 0 && historyCount + count > maxRows) {
+        int drop = qMin(historyCount, historyCount + count - maxRows);
+        historyFirst += drop;
+        historyCount -= drop;
+    }
+}
+
+int EventModel::capacity() const
+{
+    return maxRows;
+}
+
+quint32 EventModel::intern(const QString &fileName)
+{
+    auto it = nameIds.constFind(fileName);
+    if (it != nameIds.constEnd()) {
+        return it.value();
+    }
+    quint32 id = quint32(names.size());
+    names.append(fileName);
+    nameIds.insert(fileName, id);
+    return id;
+}
+
+int EventModel::physical(int row) const
+{
+    int index = head + row;
+    return (maxRows > 0 && index >= maxRows) ? index - maxRows : index;
+}
+
+void EventModel::append(const QString &fileName, EventType type, qint64 msecs)
+{
+    // Le date fuori dai 62 bit non sono rappresentabili: prima dell'epoch
+    // diventano 0, cioe' data sconosciuta
+    quint64 stamp = quint64(qBound<qint64>(0, msecs, qint64(TimeMask)));
+    pendingNames.append(intern(fileName));
+    pendingStamps.append((quint64(type) << TypeShift) | stamp);
+    if (!flushTimer->isActive()) {
+        flushTimer->start();
+    }
+}
+
+void EventModel::store(quint32 nameId, quint64 stamp)
+{
+    // Finche' il buffer non ha fatto il giro, physical(count) == size()
+    if (maxRows == 0 || nameColumn.size() < maxRows) {
+        nameColumn.append(nameId);
+        stampColumn.append(stamp);
+    } else {
+        int slot = physical(count);
+        nameColumn[slot] = nameId;
+        stampColumn[slot] = stamp;
+    }
+    ++count;
+}
+
+void EventModel::flushPending()
+{
+    flushTimer->stop();
+    int incoming = pendingNames.size();
+    if (incoming == 0) {
+        return;
+    }
+    QElapsedTimer timer;
+    timer.start();
+
+    int start = 0;
+    if (maxRows > 0) {
+        // Del blocco servono al piu' le ultime maxRows righe
+        start = qMax(0, incoming - maxRows);
+        int overflow = historyCount + count + (incoming - start) - maxRows;
+        if (overflow > 0) {
+            // Scartiamo le righe piu' vecchie per fare spazio, prima
+            // quelle dello storico
+            beginRemoveRows(QModelIndex(), 0, overflow - 1);
+            int fromHistory = qMin(overflow, historyCount);
+            historyFirst += fromHistory;
+            historyCount -= fromHistory;
+            int fromRing = overflow - fromHistory;
+            head = (head + fromRing) % maxRows;
+            count -= fromRing;
+            evicted += fromRing;
+            endRemoveRows();
+        }
+    }
+
+    int first = historyCount + count;
+    beginInsertRows(QModelIndex(), first, first + (incoming - start) - 1);
+    for (int i = start; i < incoming; ++i) {
+        store(pendingNames[i], pendingStamps[i]);
+    }
+    endInsertRows();
+
+    pendingNames.clear();
+    pendingStamps.clear();
+    if (names.size() > 2 * count + 1024) {
+        compactNames();
+    }
+    insertDuration.record(quint64(timer.nsecsElapsed() / 1000));
+    insertRows.record(quint64(incoming));
+}
+
+// Tiene solo i nomi delle righe in memoria e rinumera gli id; costa
+// O(righe) ed e' ammortizzato dalle righe arrivate da quella precedente
+void EventModel::compactNames()
+{
+    QStringList liveNames;
+    QHash<QString, quint32> liveIds;
+    QVector<quint32> remap(names.size(), quint32(-1));
+    for (int row = 0; row < count; ++row) {
+        quint32 &id = nameColumn[physical(row)];
+        if (remap[int(id)] == quint32(-1)) {
+            remap[int(id)] = quint32(liveNames.size());
+            liveNames.append(names.at(int(id)));
+            liveIds.insert(liveNames.last(), remap[int(id)]);
+        }
+        id = remap[int(id)];
+    }
+    names.swap(liveNames);
+    nameIds.swap(liveIds);
+}
+
+QString EventModel::fileName(int row) const
+{
+    if (row < historyCount) {
+        return history->name(history->nameId(historyFirst + row));
+    }
+    return names.at(nameColumn[physical(row - historyCount)]);
+}
+
+EventType EventModel::eventType(int row) const
+{
+    if (row < historyCount) {
+        return history->eventType(historyFirst + row);
+    }
+    return EventType(stampColumn[physical(row - historyCount)] >> TypeShift);
+}
+
+qint64 EventModel::time(int row) const
+{
+    if (row < historyCount) {
+        return history->time(historyFirst + row);
+    }
+    return qint64(stampColumn[physical(row - historyCount)] & TimeMask);
+}
+
+qint64 EventModel::firstSequence() const
+{
+    // historyFirst + historyCount coincide sempre con la fine dell'archivio
+    return historyFirst + evicted;
+}
+
+int EventModel::historyRows() const
+{
+    return historyCount;
+}
+
+const EventStore *EventModel::historyStore() const
+{
+    return history;
+}
+
+int EventModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : historyCount + count;
+}
+
+int EventModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QColor EventModel::eventColor(EventType type)
+{
+    return QColor(eventColorName(type));
+}
+
+QVariant EventModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= historyCount + count) {
+        return QVariant();
+    }
+    int row = index.row();
+
+    switch (index.column()) {
+    case ColorColumn:
+        if (role == Qt::BackgroundRole) {
+            return eventColor(eventType(row));
+        }
+        if (role == SortRole) {
+            return int(eventType(row));
+        }
+        break;
+    case FileColumn:
+        if (role == Qt::DisplayRole || role == SortRole) {
+            return fileName(row);
+        }
+        break;
+    case EventColumn:
+        if (role == Qt::DisplayRole) {
+            return eventName(eventType(row));
+        }
+        if (role == SortRole) {
+            return int(eventType(row));
+        }
+        break;
+    case TimeColumn:
+        if (role == Qt::DisplayRole) {
+            qint64 msecs = time(row);
+            return msecs == 0 ? QString() : QDateTime::fromMSecsSinceEpoch(msecs).toString();
+        }
+        if (role == SortRole) {
+            return time(row);
+        }
+        break;
+    }
+
+    if (role == Qt::TextAlignmentRole) {
+        return int(Qt::AlignLeft | Qt::AlignVCenter);
+    }
+    return QVariant();
+}
+
+QVariant EventModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case ColorColumn:
+        return QStringLiteral("Color");
+    case FileColumn:
+        return QStringLiteral("Filename");
+    case EventColumn:
+        return QStringLiteral("Event");
+    case TimeColumn:
+        return QStringLiteral("Time");
+    }
+    return QVariant();
+}
+
+Qt::ItemFlags EventModel::flags(const QModelIndex &index) const
+{
+    if (index.column() == ColorColumn) {
+        return Qt::NoItemFlags;
+    }
+    return QAbstractTableModel::flags(index);
+}
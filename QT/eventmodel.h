@@ -0,0 +1,103 @@
+#ifndef EVENTMODEL_H
+#define EVENTMODEL_H
+
+#include "fileevent.h"
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+class EventStore;
+class QTimer;
+
+// Modello della tabella degli eventi.
+// Gli eventi sono memorizzati per colonne: un id del nome del file
+// (i nomi sono internati una sola volta) e un intero a 64 bit che
+// contiene il tipo di evento nei 2 bit alti e i millisecondi dall'epoch
+// nei restanti. Con una capacita' > 0 le righe formano un buffer
+// circolare che scarta gli eventi piu' vecchi; quando la tabella dei nomi
+// supera il doppio delle righe viene ricostruita con i soli nomi ancora
+// presenti, cosi' anche con nomi sempre nuovi la memoria resta limitata.
+// Lo storico caricato all'avvio non viene copiato: le prime righe sono
+// lette direttamente dall'EventStore mappato, solo quando la vista le
+// chiede, e gli eventi nuovi seguono in memoria.
+class EventModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        ColorColumn,
+        FileColumn,
+        EventColumn,
+        TimeColumn,
+        ColumnCount
+    };
+
+    // Ruolo con il valore grezzo della cella, usato per l'ordinamento
+    static const int SortRole = Qt::UserRole;
+
+    explicit EventModel(QObject *parent = nullptr);
+
+    void setCapacity(int maxRows);
+    int capacity() const;
+    // Righe iniziali lette dall'archivio, che deve restare aperto
+    void setHistory(const EventStore *store);
+
+    // Accoda un evento; le righe vengono inserite nella vista a blocchi
+    void append(const QString &fileName, EventType type, qint64 msecs);
+    // Inserisce subito nel modello gli eventi accodati
+    void flushPending();
+
+    QString fileName(int row) const;
+    EventType eventType(int row) const;
+    qint64 time(int row) const;
+
+    // Numero progressivo della riga 0: la riga r e' l'evento
+    // firstSequence() + r, contando prima i record dell'archivio e poi
+    // gli eventi nuovi, anche quelli gia' scartati
+    qint64 firstSequence() const;
+    // Le prime historyRows() righe sono i record firstSequence()... di
+    // historyStore()
+    int historyRows() const;
+    const EventStore *historyStore() const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+    static QColor eventColor(EventType type);
+
+private:
+    static const int TypeShift = 62;
+    static const quint64 TimeMask = (quint64(1) << TypeShift) - 1;
+
+    quint32 intern(const QString &fileName);
+    void compactNames();
+    int physical(int row) const;
+    void store(quint32 nameId, quint64 stamp);
+
+    void trimHistory();
+
+    const EventStore *history;
+    qint64 historyFirst;
+    int historyCount;
+
+    QStringList names;
+    QHash<QString, quint32> nameIds;
+
+    QVector<quint32> nameColumn;
+    QVector<quint64> stampColumn;
+    int head;
+    int count;
+    int maxRows;
+    qint64 evicted;     // eventi nuovi scartati dal buffer circolare
+
+    QVector<quint32> pendingNames;
+    QVector<quint64> pendingStamps;
+    QTimer *flushTimer;
+};
+
+#endif // EVENTMODEL_H
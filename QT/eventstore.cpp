@@ -0,0 +1,317 @@
+#include "eventstore.h"
+#include <QDateTime>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QVector>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+static const char DataMagic[8] = {'D', 'M', 'E', 'V', 'D', 'A', 'T', '1'};
+static const char IndexMagic[8] = {'D', 'M', 'E', 'V', 'I', 'D', 'X', '1'};
+static const quint32 StoreVersion = 1;
+
+static void syncFile(QFileDevice &file)
+{
+    file.flush();
+#ifdef Q_OS_UNIX
+    ::fsync(file.handle());
+#endif
+}
+
+EventStore::EventStore(const QString &basePath)
+    : base(basePath)
+    , dataFile(basePath + ".dat")
+    , indexFile(basePath + ".idx")
+    , records(nullptr)
+    , blob(nullptr)
+    , offsets(nullptr)
+    , last(nullptr)
+{
+    std::memset(&footer, 0, sizeof(footer));
+}
+
+EventStore::~EventStore()
+{
+    close();
+}
+
+bool EventStore::validFooter(qint64 indexSize) const
+{
+    if (std::memcmp(footer.magic, IndexMagic, sizeof(IndexMagic)) != 0 || footer.version != StoreVersion) {
+        return false;
+    }
+    quint64 tables = (footer.nameCount * 2 + 1) * sizeof(quint64);
+    return footer.offsetsPos >= footer.blobSize && footer.offsetsPos % 8 == 0
+           && footer.lastPos == footer.offsetsPos + (footer.nameCount + 1) * sizeof(quint64)
+           && footer.offsetsPos + tables + sizeof(Footer) == quint64(indexSize);
+}
+
+bool EventStore::open()
+{
+    close();
+
+    if (!indexFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    qint64 indexSize = indexFile.size();
+    if (indexSize < qint64(sizeof(Footer))) {
+        close();
+        return false;
+    }
+    const uchar *index = indexFile.map(0, indexSize);
+    if (!index) {
+        close();
+        return false;
+    }
+    std::memcpy(&footer, index + indexSize - sizeof(Footer), sizeof(Footer));
+    if (!validFooter(indexSize)) {
+        close();
+        return false;
+    }
+    blob = reinterpret_cast<const char *>(index);
+    offsets = reinterpret_cast<const quint64 *>(index + footer.offsetsPos);
+    last = reinterpret_cast<const quint64 *>(index + footer.lastPos);
+
+    if (footer.recordCount > 0) {
+        qint64 length = HeaderSize + qint64(footer.recordCount) * qint64(sizeof(Record));
+        if (!dataFile.open(QIODevice::ReadOnly) || dataFile.size() < length) {
+            close();
+            return false;
+        }
+        // Si mappano solo i record confermati dal footer
+        const uchar *data = dataFile.map(0, length);
+        if (!data || std::memcmp(data, DataMagic, sizeof(DataMagic)) != 0) {
+            close();
+            return false;
+        }
+        records = reinterpret_cast<const Record *>(data + HeaderSize);
+    }
+    return true;
+}
+
+void EventStore::close()
+{
+    // QFile::close() rilascia anche le mappature
+    dataFile.close();
+    indexFile.close();
+    records = nullptr;
+    blob = nullptr;
+    offsets = nullptr;
+    last = nullptr;
+    std::memset(&footer, 0, sizeof(footer));
+}
+
+qint64 EventStore::size() const
+{
+    return qint64(footer.recordCount);
+}
+
+quint32 EventStore::nameCount() const
+{
+    return quint32(footer.nameCount);
+}
+
+quint64 EventStore::journalSequence() const
+{
+    return footer.journalSequence;
+}
+
+quint32 EventStore::nameId(qint64 row) const
+{
+    return records[row].nameId;
+}
+
+EventType EventStore::eventType(qint64 row) const
+{
+    return EventType(records[row].type);
+}
+
+qint64 EventStore::time(qint64 row) const
+{
+    return records[row].msecs;
+}
+
+QString EventStore::name(quint32 id) const
+{
+    if (id >= footer.nameCount) {
+        return QString();
+    }
+    return QString::fromUtf8(blob + offsets[id], int(offsets[id + 1] - offsets[id]));
+}
+
+QSet<QString> EventStore::liveFiles() const
+{
+    QSet<QString> files;
+    for (quint32 id = 0; id < footer.nameCount; ++id) {
+        if (EventType(last[id] >> TypeShift) != EventType::Deleted) {
+            files.insert(name(id));
+        }
+    }
+    return files;
+}
+
+bool EventStore::importJournal(const QString &basePath, const QString &journalPath, quint64 sequence)
+{
+    EventStore current(basePath);
+    if (!current.open()) {
+        // I nomi stanno solo nell'indice: con record presenti e indice
+        // mancante o danneggiato non si puo' ricostruire nulla, e ripartire
+        // da zero cancellerebbe lo storico
+        if (QFileInfo(basePath + ".dat").size() > HeaderSize) {
+            qWarning("EventStore: indice di %s non valido, importazione sospesa", qPrintable(basePath));
+            return false;
+        }
+        // Archivio nuovo: l'indice vuoto viene prima dei record, cosi'
+        // un'importazione interrotta non lascia record senza indice
+        if (!writeIndex(basePath, QByteArray(), QVector<quint64>(1, 0), QVector<quint64>(), 0, 0)
+            || !current.open()) {
+            return false;
+        }
+    }
+    if (sequence <= current.journalSequence()) {
+        return true;
+    }
+
+    // Tabelle dei nomi esistenti, copiate per essere estese
+    quint64 nameCount = current.footer.nameCount;
+    QByteArray names(current.blob, int(current.footer.blobSize));
+    QVector<quint64> nameOffsets(int(nameCount) + 1, 0);
+    QVector<quint64> lastStamps(int(nameCount), 0);
+    QHash<QString, quint32> ids;
+    ids.reserve(int(nameCount));
+    for (quint32 id = 0; id < nameCount; ++id) {
+        nameOffsets[id] = current.offsets[id];
+        lastStamps[id] = current.last[id];
+        ids.insert(current.name(id), id);
+    }
+    nameOffsets[int(nameCount)] = quint64(names.size());
+
+    QFile journal(journalPath);
+    if (!journal.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return false;
+    }
+    QByteArray added;
+    QTextStream in(&journal);
+    while (!in.atEnd()) {
+        QStringList parts;
+        if (!splitLogRecord(in.readLine(), &parts) || parts[1] == "log.txt") {
+            continue;
+        }
+        EventType type;
+        if (!parseEventType(parts[2], &type)) {
+            continue;
+        }
+        auto found = ids.constFind(parts[1]);
+        quint32 id;
+        if (found != ids.constEnd()) {
+            id = found.value();
+        } else {
+            id = quint32(nameOffsets.size() - 1);
+            ids.insert(parts[1], id);
+            names += parts[1].toUtf8();
+            nameOffsets.append(quint64(names.size()));
+            lastStamps.append(0);
+        }
+        QDateTime time = QDateTime::fromString(parts[3]);
+        Record record = {id, quint32(type), time.isValid() ? time.toMSecsSinceEpoch() : 0};
+        added.append(reinterpret_cast<const char *>(&record), sizeof(record));
+        lastStamps[int(id)] = (quint64(type) << TypeShift) | quint64(record.msecs);
+    }
+    journal.close();
+
+    quint64 recordCount = current.footer.recordCount + quint64(added.size()) / sizeof(Record);
+    qint64 committed = HeaderSize + qint64(current.footer.recordCount) * qint64(sizeof(Record));
+    current.close();
+
+    // Prima i record: finche' l'indice non cambia restano invisibili
+    QFile data(basePath + ".dat");
+    if (!data.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    if (committed == HeaderSize) {
+        QByteArray header(HeaderSize, '\0');
+        std::memcpy(header.data(), DataMagic, sizeof(DataMagic));
+        std::memcpy(header.data() + 8, &StoreVersion, sizeof(StoreVersion));
+        quint32 recordSize = sizeof(Record);
+        std::memcpy(header.data() + 12, &recordSize, sizeof(recordSize));
+        data.resize(0);
+        data.write(header);
+    }
+    data.resize(committed);
+    data.seek(committed);
+    if (data.write(added) != added.size()) {
+        return false;
+    }
+    syncFile(data);
+    data.close();
+
+    // Poi l'indice, sostituito in un colpo solo
+    return writeIndex(basePath, names, nameOffsets, lastStamps, recordCount, sequence);
+}
+
+bool EventStore::writeIndex(const QString &basePath, QByteArray names, const QVector<quint64> &nameOffsets,
+                            const QVector<quint64> &lastStamps, quint64 recordCount, quint64 sequence)
+{
+    Footer newFooter;
+    std::memset(&newFooter, 0, sizeof(newFooter));
+    std::memcpy(newFooter.magic, IndexMagic, sizeof(IndexMagic));
+    newFooter.version = StoreVersion;
+    newFooter.recordCount = recordCount;
+    newFooter.nameCount = quint64(lastStamps.size());
+    newFooter.blobSize = quint64(names.size());
+    newFooter.offsetsPos = (newFooter.blobSize + 7) / 8 * 8;
+    newFooter.lastPos = newFooter.offsetsPos + quint64(nameOffsets.size()) * sizeof(quint64);
+    newFooter.journalSequence = sequence;
+
+    QSaveFile index(basePath + ".idx");
+    if (!index.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    names.append(QByteArray(int(newFooter.offsetsPos - newFooter.blobSize), '\0'));
+    index.write(names);
+    index.write(reinterpret_cast<const char *>(nameOffsets.constData()), nameOffsets.size() * sizeof(quint64));
+    index.write(reinterpret_cast<const char *>(lastStamps.constData()), lastStamps.size() * sizeof(quint64));
+    index.write(reinterpret_cast<const char *>(&newFooter), sizeof(newFooter));
+    syncFile(index);
+    return index.commit();
+}
+
+// Sposta l'archivio in segmentBase e ne lascia uno senza record che
+// conserva i nomi dei file presenti, con il loro ultimo evento, e la
+// sequenza dei journal: liveFiles() e le importazioni successive non
+// cambiano. Un'interruzione tra le rinomine e la scrittura del nuovo
+// indice lascia l'archivio attivo vuoto, senza perdere record.
+bool EventStore::rotate(const QString &basePath, const QString &segmentBase)
+{
+    EventStore current(basePath);
+    if (!current.open() || current.size() == 0) {
+        return false;
+    }
+    QByteArray names;
+    QVector<quint64> nameOffsets(1, 0);
+    QVector<quint64> lastStamps;
+    for (quint32 id = 0; id < current.footer.nameCount; ++id) {
+        if (EventType(current.last[id] >> TypeShift) == EventType::Deleted) {
+            continue;
+        }
+        names.append(current.blob + current.offsets[id], int(current.offsets[id + 1] - current.offsets[id]));
+        nameOffsets.append(quint64(names.size()));
+        lastStamps.append(current.last[id]);
+    }
+    quint64 sequence = current.footer.journalSequence;
+    current.close();
+
+    if (!QFile::rename(basePath + ".dat", segmentBase + ".dat")) {
+        return false;
+    }
+    if (!QFile::rename(basePath + ".idx", segmentBase + ".idx")) {
+        QFile::rename(segmentBase + ".dat", basePath + ".dat");
+        return false;
+    }
+    return writeIndex(basePath, names, nameOffsets, lastStamps, 0, sequence);
+}
@@ -0,0 +1,88 @@
+#ifndef EVENTSTORE_H
+#define EVENTSTORE_H
+
+#include "fileevent.h"
+#include <QFile>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+// Archivio binario dello storico degli eventi, letto tramite mmap.
+// E' formato da due file:
+//   <base>.dat  intestazione e record a larghezza fissa di 16 byte
+//               (id del nome, tipo, millisecondi dall'epoch), solo in coda
+//   <base>.idx  tabella dei nomi internati, offset dei nomi, ultimo evento
+//               di ogni nome e un footer con i conteggi, riscritto in
+//               modo atomico a ogni importazione
+// Aprire l'archivio significa solo mappare i due file: le righe e i nomi
+// vengono letti quando servono. I record oltre il conteggio del footer
+// (importazione interrotta) vengono ignorati e poi sovrascritti.
+class EventStore
+{
+public:
+    explicit EventStore(const QString &basePath);
+    ~EventStore();
+
+    // false se l'archivio non esiste o non e' valido: resta vuoto
+    bool open();
+    void close();
+
+    qint64 size() const;
+    quint32 nameCount() const;
+    // Numero dell'ultimo journal importato
+    quint64 journalSequence() const;
+
+    quint32 nameId(qint64 row) const;
+    EventType eventType(qint64 row) const;
+    qint64 time(qint64 row) const;
+    QString name(quint32 id) const;
+
+    // File il cui ultimo evento non e' una cancellazione
+    QSet<QString> liveFiles() const;
+
+    // Accoda gli eventi di un journal testuale (formato di log.txt) e
+    // riscrive l'indice. Un journal con sequence gia' importata viene
+    // ignorato. Serve anche da convertitore del vecchio log.txt.
+    static bool importJournal(const QString &basePath, const QString &journalPath, quint64 sequence);
+    // Sposta i record in un segmento <segmentBase>.dat/.idx, leggibile
+    // come un archivio a se', e riparte da un archivio vuoto; false se
+    // non c'era nulla da spostare
+    static bool rotate(const QString &basePath, const QString &segmentBase);
+
+private:
+    struct Record {
+        quint32 nameId;
+        quint32 type;
+        qint64 msecs;
+    };
+
+    struct Footer {
+        char magic[8];
+        quint32 version;
+        quint32 reserved;
+        quint64 recordCount;
+        quint64 nameCount;
+        quint64 blobSize;
+        quint64 offsetsPos;
+        quint64 lastPos;
+        quint64 journalSequence;
+    };
+
+    static const int HeaderSize = 32;
+    static const int TypeShift = 62;
+
+    QString base;
+    QFile dataFile;
+    QFile indexFile;
+    const Record *records;
+    const char *blob;
+    const quint64 *offsets;
+    const quint64 *last;
+    Footer footer;
+
+    bool validFooter(qint64 indexSize) const;
+    static bool writeIndex(const QString &basePath, QByteArray names, const QVector<quint64> &nameOffsets,
+                           const QVector<quint64> &lastStamps, quint64 recordCount, quint64 sequence);
+};
+
+#endif // EVENTSTORE_H
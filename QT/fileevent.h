@@ -0,0 +1,85 @@
+#ifndef FILEEVENT_H
+#define FILEEVENT_H
+
+#include <QDateTime>
+#include <QList>
+#include <QMetaType>
+#include <QString>
+#include <QStringList>
+#include <QtGlobal>
+
+// Tipo di evento rilevato su un file
+enum class EventType : quint8 {
+    Created = 0,
+    Modified = 1,
+    Deleted = 2
+};
+
+// Nome dell'evento come compare nella tabella e nel log
+inline QString eventName(EventType type)
+{
+    switch (type) {
+    case EventType::Created:
+        return QStringLiteral("Created");
+    case EventType::Modified:
+        return QStringLiteral("Modified");
+    case EventType::Deleted:
+        return QStringLiteral("Deleted");
+    }
+    return QString();
+}
+
+// Colore dell'evento nel formato #rrggbb, primo campo dei record del log
+inline QString eventColorName(EventType type)
+{
+    switch (type) {
+    case EventType::Created:
+        return QStringLiteral("#00ff00");
+    case EventType::Modified:
+        return QStringLiteral("#0000ff");
+    case EventType::Deleted:
+        return QStringLiteral("#ff0000");
+    }
+    return QString();
+}
+
+inline bool parseEventType(const QString &name, EventType *type)
+{
+    if (name == QLatin1String("Created")) {
+        *type = EventType::Created;
+    } else if (name == QLatin1String("Modified")) {
+        *type = EventType::Modified;
+    } else if (name == QLatin1String("Deleted")) {
+        *type = EventType::Deleted;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Campi di un record del log, "colore;file;evento;data": il nome del file
+// puo' contenere ';', quindi colore e' prima del primo separatore ed
+// evento e data dopo gli ultimi due. false se i separatori sono meno di 3.
+inline bool splitLogRecord(const QString &line, QStringList *fields)
+{
+    int first = line.indexOf(QLatin1Char(';'));
+    int last = line.lastIndexOf(QLatin1Char(';'));
+    int middle = last > 0 ? line.lastIndexOf(QLatin1Char(';'), last - 1) : -1;
+    if (first < 0 || middle <= first) {
+        return false;
+    }
+    *fields = QStringList() << line.left(first) << line.mid(first + 1, middle - first - 1)
+                            << line.mid(middle + 1, last - middle - 1) << line.mid(last + 1);
+    return true;
+}
+
+// Evento rilevato dallo scanner e consegnato alla finestra
+struct FileEvent {
+    QString fileName;
+    EventType type;
+    QDateTime time;
+};
+
+Q_DECLARE_METATYPE(FileEvent)
+
+#endif // FILEEVENT_H
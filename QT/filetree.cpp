@@ -0,0 +1,700 @@
+#include "filetree.h"
+#include "workerpool.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#ifdef __linux__
+// Record restituito dalla syscall getdents64
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+#endif
+
+// Ampiezza della finestra in cui una lettura e' considerata a rischio:
+// copre anche i filesystem con date a 2 s (FAT)
+static const int64_t RacyWindowNs = 2000000000;
+
+static int64_t toNs(const struct timespec &ts)
+{
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static int64_t mtimeMs(const struct stat &st)
+{
+#ifdef __APPLE__
+    return int64_t(st.st_mtimespec.tv_sec) * 1000 + st.st_mtimespec.tv_nsec / 1000000;
+#else
+    return int64_t(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000;
+#endif
+}
+
+static ContentHasher::Key keyOf(const struct stat &st)
+{
+    ContentHasher::Key key;
+    key.inode = st.st_ino;
+    key.size = static_cast<uint64_t>(st.st_size);
+#ifdef __APPLE__
+    key.mtimeNs = toNs(st.st_mtimespec);
+    key.ctimeNs = toNs(st.st_ctimespec);
+#else
+    key.mtimeNs = toNs(st.st_mtim);
+    key.ctimeNs = toNs(st.st_ctim);
+#endif
+    return key;
+}
+
+// Classifica una voce della cartella aperta in dirFd come nella versione
+// non ricorsiva (QDir::Files): file regolari e link a file regolari; i
+// link a cartelle non vengono seguiti per non entrare in cicli.
+// Restituisce 1 per un file, 2 per una cartella, 0 altrimenti.
+static int classify(int dirFd, const char *name, unsigned char type, struct stat *st)
+{
+    if (type == DT_DIR) {
+        return 2;
+    }
+    if (type == DT_REG || type == DT_UNKNOWN) {
+        if (fstatat(dirFd, name, st, AT_SYMLINK_NOFOLLOW) != 0) {
+            return 0;
+        }
+        if (S_ISDIR(st->st_mode)) {
+            return 2;
+        }
+        if (S_ISREG(st->st_mode)) {
+            return 1;
+        }
+        if (!S_ISLNK(st->st_mode)) {
+            return 0;
+        }
+    } else if (type != DT_LNK) {
+        return 0;
+    }
+    if (fstatat(dirFd, name, st, 0) == 0 && S_ISREG(st->st_mode)) {
+        return 1;
+    }
+    return 0;
+}
+
+FileTree::FileTree(const std::string &rootPath)
+    : root(rootPath)
+    , threadCount(0)
+    , files(0)
+    , generation(0)
+    , stats(0)
+    , skipped(0)
+    , crawlMode(FullCrawl)
+    , outstanding(0)
+{
+    while (root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+    entries.push_back(Entry{0, 0, Absent});
+    listed.push_back(true);
+    newDirectory(PathTrie::Root);
+    addedDirs.clear();
+}
+
+void FileTree::setThreads(unsigned threads)
+{
+    threadCount = threads;
+}
+
+void FileTree::setContentHashing(const ContentHasher::Options &options)
+{
+    hasher.setOptions(options);
+    if (!options.enabled) {
+        fingerprints.clear();
+        baseline.clear();
+    }
+}
+
+std::string FileTree::absolutePath(uint32_t node) const
+{
+    if (node == PathTrie::Root) {
+        return root;
+    }
+    return root + "/" + trie.path(node);
+}
+
+uint32_t FileTree::child(uint32_t parent, const char *name, size_t len)
+{
+    uint32_t node = trie.insert(parent, name, len);
+    if (node >= entries.size()) {
+        entries.resize(node + 1, Entry{0, 0, Absent});
+        listed.resize(node + 1, false);
+    }
+    return node;
+}
+
+uint32_t FileTree::newDirectory(uint32_t node)
+{
+    uint32_t index;
+    if (!freeDirs.empty()) {
+        index = freeDirs.back();
+        freeDirs.pop_back();
+        dirs[index].node = node;
+        dirs[index].stamp = ContentHasher::Key();
+        dirs[index].children.clear();
+    } else {
+        index = static_cast<uint32_t>(dirs.size());
+        dirs.push_back(DirState{node, ContentHasher::Key(), {}});
+    }
+    entries[node].dir = index;
+    addedDirs.push_back(node);
+    return index;
+}
+
+void FileTree::updateFile(uint32_t node, const FileStat &stat, std::vector<Change> &changes)
+{
+    if (entries[node].dir < IsFile) {
+        removeSubtree(node, changes);
+    }
+
+    Entry &f = entries[node];
+    if (f.dir != IsFile) {
+        f.dir = IsFile;
+        f.mtime = stat.mtime;
+        ++files;
+        changes.push_back(Change{node, Created, stat.mtime});
+        if (hasher.options().enabled) {
+            fingerprints[node] = Fingerprint();
+            baseline.push_back(node);
+        }
+        return;
+    }
+
+    if (hasher.options().enabled) {
+        auto found = fingerprints.find(node);
+        if (found == fingerprints.end()) {
+            found = fingerprints.emplace(node, Fingerprint()).first;
+            baseline.push_back(node);
+        }
+        Fingerprint &fp = found->second;
+        if (fp.state == Hashed) {
+            // La decisione spetta a resolveSuspects()
+            if (fp.key != stat.key || fp.racy) {
+                suspects.push_back(Suspect{node, stat.mtime, stat.key.size});
+            }
+            f.mtime = std::max(f.mtime, stat.mtime);
+            return;
+        }
+        // Impronta non ancora disponibile o file troppo grande: vale la data
+        if (fp.state == Unhashable && fp.key != stat.key) {
+            fp.state = HashPending;
+            baseline.push_back(node);
+        }
+    }
+
+    if (f.mtime < stat.mtime) {
+        f.mtime = stat.mtime;
+        changes.push_back(Change{node, Modified, stat.mtime});
+    }
+}
+
+void FileTree::removeFile(uint32_t node, std::vector<Change> &changes)
+{
+    entries[node].dir = Absent;
+    fingerprints.erase(node);
+    --files;
+    changes.push_back(Change{node, Deleted, 0});
+}
+
+void FileTree::removeSubtree(uint32_t node, std::vector<Change> &changes)
+{
+    std::vector<uint32_t> stack(1, node);
+    while (!stack.empty()) {
+        uint32_t current = stack.back();
+        stack.pop_back();
+
+        uint32_t index = entries[current].dir;
+        std::vector<uint32_t> children;
+        children.swap(dirs[index].children);
+        for (uint32_t c : children) {
+            listed[c] = false;
+            if (entries[c].dir == IsFile) {
+                removeFile(c, changes);
+            } else if (entries[c].dir != Absent) {
+                stack.push_back(c);
+            }
+        }
+
+        entries[current].dir = Absent;
+        freeDirs.push_back(index);
+        removedDirs.push_back(current);
+    }
+}
+
+// Cartella nota piu' profonda lungo path; exact indica se e' path stesso
+uint32_t FileTree::nearestDirectory(const std::string &path, bool *exact) const
+{
+    uint32_t node = PathTrie::Root;
+    size_t start = 0;
+    *exact = true;
+    while (start < path.size()) {
+        size_t end = path.find('/', start);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        if (end > start) {
+            uint32_t next = trie.find(node, path.data() + start, end - start);
+            if (next == PathTrie::None || entries[next].dir >= IsFile) {
+                *exact = false;
+                return node;
+            }
+            node = next;
+        }
+        start = end + 1;
+    }
+    return node;
+}
+
+void FileTree::crawl(const std::string &dir, std::vector<Change> &changes, CrawlMode mode)
+{
+    ++generation;
+    crawlMode = mode;
+
+    bool exact;
+    uint32_t start = nearestDirectory(dir, &exact);
+    struct stat st;
+    if (exact && start != PathTrie::Root
+        && (stat(absolutePath(start).c_str(), &st) != 0 || !S_ISDIR(st.st_mode))) {
+        // La cartella e' sparita: la rilettura della cartella che la
+        // conteneva lo rileva
+        start = trie.parent(start);
+        exact = false;
+    }
+
+    // Il primo elenco nel thread chiamante: un crawl di una sola
+    // cartella non coinvolge il gruppo di thread
+    Work first{start, absolutePath(start), exact};
+    outstanding = 1;
+    process(first, changes);
+    if (queue.empty()) {
+        resolveSuspects(changes);
+        return;
+    }
+
+    unsigned threads = threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+    WorkerPool::global().run(threads, [this, &changes] { worker(&changes); });
+    resolveSuspects(changes);
+}
+
+void FileTree::worker(std::vector<Change> *changes)
+{
+    for (;;) {
+        Work work;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueReady.wait(lock, [this] { return !queue.empty() || outstanding == 0; });
+            if (queue.empty()) {
+                return;
+            }
+            work = std::move(queue.back());
+            queue.pop_back();
+        }
+        process(work, *changes);
+    }
+}
+
+// Errori di lettura di una cartella che non dicono che e' sparita
+static bool transientError(int error)
+{
+    return error == EACCES || error == EPERM || error == EMFILE || error == ENFILE
+           || error == EIO || error == ENOMEM || error == EINTR;
+}
+
+void FileTree::process(const Work &work, std::vector<Change> &changes)
+{
+    std::vector<Listed> list;
+    std::string nameBuffer;
+    ContentHasher::Key stamp;
+    std::vector<Work> subdirs;
+    bool skip = false;
+    bool failed = false;
+
+    // L'elenco e le stat avvengono senza lock
+    int fd = open(work.absPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        failed = transientError(errno);
+    } else {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            stamp = keyOf(st);
+            // Con la granularita' delle date una modifica successiva a
+            // questo elenco potrebbe lasciare la chiave uguale
+            if (stamp.mtimeNs + RacyWindowNs > toNs(now) || stamp.ctimeNs + RacyWindowNs > toNs(now)) {
+                stamp = ContentHasher::Key();
+            }
+        }
+        if (crawlMode == SkipUnchanged && stamp.inode != 0) {
+            std::lock_guard<std::mutex> lock(treeMutex);
+            skip = unchanged(work, stamp, subdirs);
+        }
+    }
+    if (fd >= 0 && skip) {
+        close(fd);
+    } else if (fd >= 0) {
+
+        auto add = [&](const char *name, unsigned char type) {
+            // Nascosti esclusi come in QDir::Files, insieme a . e ..
+            if (name[0] == '.') {
+                return;
+            }
+            struct stat st;
+            int kind = classify(fd, name, type, &st);
+            if (kind == 0) {
+                return;
+            }
+            FileStat stat = {0, ContentHasher::Key()};
+            if (kind == 1) {
+                stat.mtime = mtimeMs(st);
+                stat.key = keyOf(st);
+            }
+            size_t len = std::strlen(name);
+            list.push_back(Listed{static_cast<uint32_t>(nameBuffer.size()), static_cast<uint16_t>(len),
+                                  kind == 2, stat});
+            nameBuffer.append(name, len);
+        };
+
+#ifdef __linux__
+        alignas(LinuxDirent64) char buffer[64 * 1024];
+        for (;;) {
+            long len = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+            if (len < 0) {
+                failed = transientError(errno);
+            }
+            if (len <= 0) {
+                break;
+            }
+            for (long pos = 0; pos < len;) {
+                const LinuxDirent64 *d = reinterpret_cast<const LinuxDirent64 *>(buffer + pos);
+                add(d->d_name, d->d_type);
+                pos += d->d_reclen;
+            }
+        }
+        close(fd);
+#else
+        DIR *d = fdopendir(fd);
+        if (d) {
+            while (struct dirent *e = readdir(d)) {
+                add(e->d_name, e->d_type);
+            }
+            closedir(d);
+        } else {
+            failed = transientError(errno);
+            close(fd);
+        }
+#endif
+    }
+
+    if (failed) {
+        // Un elenco non letto per un errore passeggero non dice nulla sul
+        // contenuto: restano i figli noti e la chiave precedente. Una
+        // cartella sparita (ENOENT, ENOTDIR) risulta invece vuota.
+        std::lock_guard<std::mutex> lock(treeMutex);
+        if (entries[work.node].dir < IsFile) {
+            knownSubdirs(work, subdirs);
+        }
+    } else if (!skip) {
+        std::lock_guard<std::mutex> lock(treeMutex);
+        merge(work, stamp, list, nameBuffer, changes, subdirs);
+    }
+
+    std::lock_guard<std::mutex> lock(queueMutex);
+    outstanding += subdirs.size();
+    for (Work &w : subdirs) {
+        queue.push_back(std::move(w));
+    }
+    --outstanding;
+    if (outstanding == 0 || !subdirs.empty()) {
+        queueReady.notify_all();
+    }
+}
+
+// Cartella invariata dall'ultimo elenco: i figli noti restano validi e
+// si scende solo nelle sottocartelle note
+bool FileTree::unchanged(const Work &work, const ContentHasher::Key &stamp, std::vector<Work> &subdirs)
+{
+    if (entries[work.node].dir >= IsFile) {
+        return false;
+    }
+    const DirState &d = dirs[entries[work.node].dir];
+    if (d.stamp != stamp) {
+        return false;
+    }
+    ++stats;
+    ++skipped;
+    knownSubdirs(work, subdirs);
+    return true;
+}
+
+// Sottocartelle note di una cartella non rielencata, se la rilettura
+// deve scendere
+void FileTree::knownSubdirs(const Work &work, std::vector<Work> &subdirs) const
+{
+    if (!work.deep) {
+        return;
+    }
+    for (uint32_t c : dirs[entries[work.node].dir].children) {
+        if (entries[c].dir < IsFile) {
+            subdirs.push_back(Work{c, work.absPath + "/" + trie.name(c), true});
+        }
+    }
+}
+
+void FileTree::merge(const Work &work, const ContentHasher::Key &stamp, const std::vector<Listed> &list,
+                     const std::string &nameBuffer, std::vector<Change> &changes,
+                     std::vector<Work> &subdirs)
+{
+    if (entries[work.node].dir >= IsFile) {
+        // Rimossa nel frattempo da un'altra rilettura
+        return;
+    }
+
+    // La cartella stessa piu' le sue voci
+    stats += list.size() + 1;
+
+    std::vector<uint32_t> seen;
+    seen.reserve(list.size());
+    for (const Listed &l : list) {
+        const char *name = nameBuffer.data() + l.nameOffset;
+        uint32_t node = child(work.node, name, l.nameLen);
+        Entry &e = entries[node];
+        if (e.seen == generation) {
+            continue;
+        }
+        e.seen = generation;
+        seen.push_back(node);
+
+        if (l.isDir) {
+            if (e.dir == IsFile) {
+                removeFile(node, changes);
+            }
+            bool isNew = entries[node].dir == Absent;
+            if (isNew) {
+                newDirectory(node);
+            }
+            if (work.deep || isNew) {
+                subdirs.push_back(Work{node, work.absPath + "/" + std::string(name, l.nameLen), true});
+            }
+        } else {
+            updateFile(node, l.stat, changes);
+        }
+    }
+
+    // I figli noti non piu' presenti sono stati cancellati
+    DirState &d = dirs[entries[work.node].dir];
+    d.stamp = stamp;
+    std::vector<uint32_t> previous;
+    previous.swap(d.children);
+    for (uint32_t c : previous) {
+        listed[c] = false;
+        if (entries[c].seen == generation) {
+            continue;
+        }
+        if (entries[c].dir == IsFile) {
+            removeFile(c, changes);
+        } else if (entries[c].dir != Absent) {
+            removeSubtree(c, changes);
+        }
+    }
+    for (uint32_t c : seen) {
+        listed[c] = true;
+    }
+    dirs[entries[work.node].dir].children.swap(seen);
+}
+
+void FileTree::checkFile(const std::string &path, std::vector<Change> &changes)
+{
+    size_t slash = path.rfind('/');
+    std::string dirPath = slash == std::string::npos ? std::string() : path.substr(0, slash);
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    if (name.empty()) {
+        return;
+    }
+
+    bool exact;
+    uint32_t parent = nearestDirectory(dirPath, &exact);
+    if (!exact) {
+        return;
+    }
+
+    struct stat st;
+    int kind = 0;
+    if (name[0] != '.') {
+        ++stats;
+        kind = classify(AT_FDCWD, (absolutePath(parent) + "/" + name).c_str(), DT_UNKNOWN, &st);
+    }
+    if (kind == 2) {
+        // Le cartelle passano da crawl()
+        return;
+    }
+
+    uint32_t node = kind == 1 ? child(parent, name.data(), name.size())
+                              : trie.find(parent, name.data(), name.size());
+    if (node == PathTrie::None) {
+        return;
+    }
+
+    if (kind == 0) {
+        if (entries[node].dir == IsFile) {
+            removeFile(node, changes);
+        }
+        return;
+    }
+    updateFile(node, FileStat{mtimeMs(st), keyOf(st)}, changes);
+    if (!listed[node]) {
+        listed[node] = true;
+        dirs[entries[parent].dir].children.push_back(node);
+    }
+}
+
+void FileTree::checkFiles(const std::vector<std::string> &paths, std::vector<Change> &changes)
+{
+    for (const std::string &path : paths) {
+        checkFile(path, changes);
+    }
+    resolveSuspects(changes);
+}
+
+// Rilegge in parallelo i file con chiave cambiata e segnala come
+// modificati solo quelli con un'impronta diversa. Con bytesPerSecond
+// legge un lotto alla volta come hashPending(): il resto aspetta in coda
+// e viene ripreso da checkSuspects().
+void FileTree::resolveSuspects(std::vector<Change> &changes)
+{
+    if (suspects.empty() || hasher.pauseMs() > 0) {
+        return;
+    }
+
+    uint64_t budget = hasher.batchBytes();
+    uint64_t bytes = 0;
+    size_t count = 0;
+    while (count < suspects.size() && (count == 0 || bytes + suspects[count].size <= budget)) {
+        bytes += suspects[count].size;
+        ++count;
+    }
+
+    std::vector<ContentHasher::Job> jobs(count);
+    for (size_t i = 0; i < count; ++i) {
+        jobs[i].path = absolutePath(suspects[i].node);
+    }
+    hasher.hash(jobs);
+
+    for (size_t i = 0; i < count; ++i) {
+        const Suspect &s = suspects[i];
+        const ContentHasher::Job &job = jobs[i];
+        auto fp = fingerprints.find(s.node);
+        // Cancellato o ricreato mentre era in coda
+        if (entries[s.node].dir != IsFile || fp == fingerprints.end() || fp->second.state != Hashed) {
+            continue;
+        }
+        if (!job.ok && job.key.inode == 0) {
+            // Sparito nel frattempo: la cancellazione arrivera' a parte
+            continue;
+        }
+        bool changed = !job.ok || job.hash != fp->second.hash;
+        store(fp->second, job);
+        if (changed) {
+            changes.push_back(Change{s.node, Modified, s.mtime});
+        }
+    }
+    suspects.erase(suspects.begin(), suspects.begin() + count);
+}
+
+void FileTree::store(Fingerprint &fp, const ContentHasher::Job &job)
+{
+    fp.key = job.key;
+    fp.hash = job.hash;
+    fp.state = job.ok ? Hashed : Unhashable;
+    fp.racy = job.ok && job.key.mtimeNs + RacyWindowNs > job.startNs;
+}
+
+size_t FileTree::hashPending(size_t maxFiles)
+{
+    if (hasher.pauseMs() > 0) {
+        return baseline.size();
+    }
+    std::vector<uint32_t> nodes;
+    while (!baseline.empty() && nodes.size() < maxFiles) {
+        uint32_t node = baseline.back();
+        baseline.pop_back();
+        auto fp = fingerprints.find(node);
+        if (entries[node].dir == IsFile && fp != fingerprints.end() && fp->second.state == HashPending) {
+            nodes.push_back(node);
+        }
+    }
+    if (nodes.empty()) {
+        return baseline.size();
+    }
+
+    std::vector<ContentHasher::Job> jobs(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        jobs[i].path = absolutePath(nodes[i]);
+    }
+    hasher.hash(jobs);
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        auto fp = fingerprints.find(nodes[i]);
+        if (fp != fingerprints.end() && jobs[i].key.inode != 0) {
+            store(fp->second, jobs[i]);
+        }
+    }
+    return baseline.size();
+}
+
+void FileTree::takeDirectoryChanges(std::vector<std::string> &added, std::vector<std::string> &removed)
+{
+    added.clear();
+    removed.clear();
+    for (uint32_t node : addedDirs) {
+        if (entries[node].dir < IsFile) {
+            added.push_back(trie.path(node));
+        }
+    }
+    for (uint32_t node : removedDirs) {
+        removed.push_back(trie.path(node));
+    }
+    addedDirs.clear();
+    removedDirs.clear();
+}
+
+void FileTree::directoryPaths(std::vector<std::string> &paths) const
+{
+    paths.clear();
+    for (uint32_t index = 0; index < dirs.size(); ++index) {
+        uint32_t node = dirs[index].node;
+        if (node != PathTrie::Root && entries[node].dir == index) {
+            paths.push_back(trie.path(node));
+        }
+    }
+}
+
+size_t FileTree::memoryUsage() const
+{
+    size_t bytes = trie.memoryUsage() + entries.capacity() * sizeof(Entry)
+                   + fingerprints.size() * (sizeof(Fingerprint) + 2 * sizeof(void *) + sizeof(uint32_t))
+                   + baseline.capacity() * sizeof(uint32_t)
+                   + listed.capacity() / 8 + dirs.capacity() * sizeof(DirState)
+                   + freeDirs.capacity() * sizeof(uint32_t);
+    for (const DirState &d : dirs) {
+        bytes += d.children.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
@@ -0,0 +1,182 @@
+#ifndef FILETREE_H
+#define FILETREE_H
+
+#include "contenthasher.h"
+#include "pathtrie.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Stato dell'albero monitorato, ricorsivo.
+// Sostituisce la mappa piatta nome -> data di modifica: i percorsi stanno
+// in un PathTrie, ogni nodo ha 16 byte di stato e ogni cartella una voce
+// nella tabella delle cartelle con i figli visti all'ultimo elenco.
+// crawl() rilegge un sottoalbero con i thread condivisi di WorkerPool
+// (getdents64 + fstatat su Linux) e confronta quanto trovato con lo stato noto; le differenze
+// vengono restituite come Change.
+// Con SkipUnchanged una cartella con inode, dimensione, mtime e ctime
+// uguali all'ultimo elenco non viene riletta: costa una sola fstat, ma
+// non vede le modifiche al contenuto dei file, che non cambiano la
+// cartella. Va usato solo quando quelle arrivano da altre fonti (inotify).
+// Con le impronte attive un file e' modificato solo se cambia il suo
+// contenuto: quando inode, dimensione, mtime o ctime cambiano il file
+// viene riletto e confrontato con l'impronta precedente, altrimenti non
+// viene letto affatto.
+class FileTree
+{
+public:
+    enum ChangeType { Created, Modified, Deleted };
+    enum CrawlMode { FullCrawl, SkipUnchanged };
+
+    struct Change {
+        uint32_t node;
+        ChangeType type;
+        int64_t mtime;      // ms dall'epoch, 0 per Deleted
+    };
+
+    explicit FileTree(const std::string &rootPath);
+
+    // 0 = un thread per core
+    void setThreads(unsigned threads);
+    void setContentHashing(const ContentHasher::Options &options);
+
+    // Rilegge la cartella relativa dir e tutto cio' che contiene. Se dir
+    // non e' una cartella nota rilegge la cartella nota piu' vicina,
+    // scendendo solo nelle sottocartelle nuove.
+    void crawl(const std::string &dir, std::vector<Change> &changes, CrawlMode mode = FullCrawl);
+    // Controlla singoli file; ignorati se la loro cartella non e' nota
+    void checkFiles(const std::vector<std::string> &paths, std::vector<Change> &changes);
+
+    // Calcola l'impronta iniziale di al piu' maxFiles file non ancora
+    // letti; restituisce quanti ne restano. Non legge nulla finche'
+    // hashPause() non torna a 0.
+    size_t hashPending(size_t maxFiles);
+    // Rilegge i file modificati rimasti in attesa del limite di lettura
+    void checkSuspects(std::vector<Change> &changes) { resolveSuspects(changes); }
+    size_t pendingSuspects() const { return suspects.size(); }
+    size_t pendingHashes() const { return baseline.size() + suspects.size(); }
+    // Millisecondi prima del prossimo lotto secondo bytesPerSecond
+    int hashPause() const { return hasher.pauseMs(); }
+
+    std::string path(uint32_t node) const { return trie.path(node); }
+
+    // Cartelle comparse e scomparse dall'ultima chiamata, per i watch
+    void takeDirectoryChanges(std::vector<std::string> &added, std::vector<std::string> &removed);
+    // Tutte le cartelle note tranne la radice
+    void directoryPaths(std::vector<std::string> &paths) const;
+
+    // Voci lette con stat dalla creazione, per le metriche
+    uint64_t statCount() const { return stats; }
+    // Cartelle non rilette perche' invariate, dalla creazione
+    uint64_t skippedCount() const { return skipped; }
+
+    size_t fileCount() const { return files; }
+    size_t directoryCount() const { return dirs.size() - freeDirs.size(); }
+    size_t memoryUsage() const;
+
+private:
+    static constexpr uint32_t Absent = 0xffffffffu;
+    static constexpr uint32_t IsFile = 0xfffffffeu;
+
+    struct Entry {
+        int64_t mtime;
+        uint32_t seen;      // generazione dell'ultimo elenco che l'ha visto
+        uint32_t dir;       // Absent, IsFile o indice in dirs
+    };
+
+    struct DirState {
+        uint32_t node;
+        // Chiave della cartella all'ultimo elenco; vuota se quell'elenco
+        // era troppo vicino all'ultima modifica per fidarsi
+        ContentHasher::Key stamp;
+        std::vector<uint32_t> children;
+    };
+
+    struct FileStat {
+        int64_t mtime;      // ms, come in Entry
+        ContentHasher::Key key;
+    };
+
+    struct Listed {
+        uint32_t nameOffset;
+        uint16_t nameLen;
+        bool isDir;
+        FileStat stat;
+    };
+
+    enum HashState : uint8_t { HashPending, Hashed, Unhashable };
+
+    struct Fingerprint {
+        ContentHasher::Key key;
+        uint64_t hash = 0;
+        HashState state = HashPending;
+        // Modificato a ridosso della lettura: con la granularita' delle
+        // date una nuova scrittura potrebbe non cambiare la chiave
+        bool racy = false;
+    };
+
+    struct Suspect {
+        uint32_t node;
+        int64_t mtime;
+        uint64_t size;
+    };
+
+    struct Work {
+        uint32_t node;
+        std::string absPath;
+        bool deep;
+    };
+
+    std::string root;
+    unsigned threadCount;
+
+    PathTrie trie;
+    std::vector<Entry> entries;
+    std::vector<bool> listed;       // nodo presente nei children della sua cartella
+    std::vector<DirState> dirs;
+    std::vector<uint32_t> freeDirs;
+    size_t files;
+    uint32_t generation;
+    uint64_t stats;
+    uint64_t skipped;
+    std::vector<uint32_t> addedDirs;
+    std::vector<uint32_t> removedDirs;
+
+    ContentHasher hasher;
+    std::unordered_map<uint32_t, Fingerprint> fingerprints;
+    std::deque<Suspect> suspects;
+    std::vector<uint32_t> baseline;
+
+    // Stato condiviso durante crawl()
+    CrawlMode crawlMode;
+    std::mutex treeMutex;
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::vector<Work> queue;
+    size_t outstanding;
+
+    std::string absolutePath(uint32_t node) const;
+    uint32_t nearestDirectory(const std::string &path, bool *exact) const;
+    uint32_t child(uint32_t parent, const char *name, size_t len);
+    uint32_t newDirectory(uint32_t node);
+    void updateFile(uint32_t node, const FileStat &stat, std::vector<Change> &changes);
+    void removeFile(uint32_t node, std::vector<Change> &changes);
+    void removeSubtree(uint32_t node, std::vector<Change> &changes);
+
+    void checkFile(const std::string &path, std::vector<Change> &changes);
+    void resolveSuspects(std::vector<Change> &changes);
+    void store(Fingerprint &fp, const ContentHasher::Job &job);
+
+    void worker(std::vector<Change> *changes);
+    void process(const Work &work, std::vector<Change> &changes);
+    bool unchanged(const Work &work, const ContentHasher::Key &stamp, std::vector<Work> &subdirs);
+    void knownSubdirs(const Work &work, std::vector<Work> &subdirs) const;
+    void merge(const Work &work, const ContentHasher::Key &stamp, const std::vector<Listed> &list,
+               const std::string &nameBuffer, std::vector<Change> &changes,
+               std::vector<Work> &subdirs);
+};
+
+#endif // FILETREE_H
@@ -0,0 +1,335 @@
+#include "logarchiver.h"
+#include "eventstore.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+static const char ArchiveMagic[8] = {'D', 'M', 'E', 'V', 'A', 'R', 'C', '1'};
+static const int HeaderSize = 24;
+static const qint64 ChunkSize = 256 * 1024;
+
+// Segmenti di storeBase per numero, con il suffisso indicato
+static QMap<int, QString> segmentFiles(const QString &storeBase, const QString &suffix)
+{
+    QFileInfo info(storeBase);
+    QDir dir = info.dir();
+    QString prefix = info.fileName() + ".archive.";
+    QMap<int, QString> files;
+    const QStringList entries = dir.entryList(QStringList() << prefix + "*" + suffix, QDir::Files | QDir::Hidden);
+    for (const QString &entry : entries) {
+        bool ok;
+        int number = entry.mid(prefix.size(), entry.size() - prefix.size() - suffix.size()).toInt(&ok);
+        if (ok) {
+            files.insert(number, dir.filePath(entry));
+        }
+    }
+    return files;
+}
+
+LogArchiver::LogArchiver(QObject *parent)
+    : QThread(parent)
+    , stopping(false)
+{
+}
+
+LogArchiver::~LogArchiver()
+{
+    stop();
+}
+
+void LogArchiver::setOptions(const Options &options)
+{
+    QMutexLocker locker(&mutex);
+    opts = options;
+}
+
+int LogArchiver::nextSegment(const QString &storeBase)
+{
+    int last = 0;
+    for (const QString &suffix : {QStringLiteral(".gz"), QStringLiteral(".idx"), QStringLiteral(".dat")}) {
+        QMap<int, QString> files = segmentFiles(storeBase, suffix);
+        if (!files.isEmpty()) {
+            last = qMax(last, files.lastKey());
+        }
+    }
+    return last + 1;
+}
+
+bool LogArchiver::rotateIfNeeded(const QString &storeBase)
+{
+    Options current;
+    {
+        QMutexLocker locker(&mutex);
+        current = opts;
+    }
+    bool rotate = current.maxSegmentBytes > 0 && QFileInfo(storeBase + ".dat").size() >= current.maxSegmentBytes;
+    if (!rotate && current.maxSegmentDays > 0) {
+        EventStore store(storeBase);
+        qint64 limit = QDateTime::currentMSecsSinceEpoch() - qint64(current.maxSegmentDays) * 86400000;
+        rotate = store.open() && store.size() > 0 && store.time(0) < limit;
+    }
+    if (!rotate) {
+        return false;
+    }
+
+    QString segment = storeBase + ".archive." + QString::number(nextSegment(storeBase));
+    if (!EventStore::rotate(storeBase, segment)) {
+        return false;
+    }
+    enqueue(Job{storeBase, segment});
+    return true;
+}
+
+void LogArchiver::checkpoint(const QString &storeBase, const QString &journal, quint64 sequence)
+{
+    enqueue(Job{storeBase, journal, sequence});
+}
+
+void LogArchiver::resume(const QString &storeBase)
+{
+    const QMap<int, QString> indexes = segmentFiles(storeBase, ".idx");
+    for (const QString &index : indexes) {
+        QString segment = index.left(index.size() - 4);
+        if (QFile::exists(segment + ".gz")) {
+            // Compresso, ma chiuso prima di cancellare l'originale
+            QFile::remove(segment + ".dat");
+            QFile::remove(segment + ".idx");
+        } else {
+            enqueue(Job{storeBase, segment});
+        }
+    }
+}
+
+void LogArchiver::enqueue(const Job &job)
+{
+    QMutexLocker locker(&mutex);
+    queue.append(job);
+    wake.wakeOne();
+}
+
+void LogArchiver::stop()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        wake.wakeOne();
+    }
+    requestInterruption();
+    wait();
+}
+
+QStringList LogArchiver::archives(const QString &storeBase)
+{
+    return segmentFiles(storeBase, ".gz").values();
+}
+
+void LogArchiver::run()
+{
+    QMutexLocker locker(&mutex);
+    for (;;) {
+        while (queue.isEmpty() && !stopping) {
+            wake.wait(&mutex);
+        }
+        if (stopping) {
+            // I checkpoint in coda si completano, sono quello di chiusura;
+            // i segmenti da comprimere vengono ripresi al prossimo avvio
+            auto import = std::find_if(queue.begin(), queue.end(), [](const Job &j) { return j.sequence != 0; });
+            if (import == queue.end()) {
+                break;
+            }
+            std::rotate(queue.begin(), import, import + 1);
+        }
+        Job job = queue.takeFirst();
+        Options current = opts;
+        locker.unlock();
+
+        if (job.sequence != 0) {
+            if (EventStore::importJournal(job.storeBase, job.segment, job.sequence)) {
+                QFile::remove(job.segment);
+                if (!isInterruptionRequested()) {
+                    rotateIfNeeded(job.storeBase);
+                }
+            }
+        } else if (compress(job.segment, current.compressionLevel)) {
+            QFile::remove(job.segment + ".dat");
+            QFile::remove(job.segment + ".idx");
+            enforceRetention(job.storeBase, current);
+        }
+
+        locker.relock();
+    }
+}
+
+// Formato: "DMEVARC1", dimensione dell'indice e dei dati (quint64),
+// poi il contenuto dei due file, tutto in un unico flusso gzip
+bool LogArchiver::compress(const QString &segment, int level)
+{
+    QFile index(segment + ".idx");
+    QFile data(segment + ".dat");
+    if (!index.open(QIODevice::ReadOnly) || !data.open(QIODevice::ReadOnly)) {
+        qWarning("LogArchiver: segmento incompleto %s", qPrintable(segment));
+        return false;
+    }
+    QSaveFile out(segment + ".gz");
+    if (!out.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    z_stream z;
+    std::memset(&z, 0, sizeof(z));
+    if (deflateInit2(&z, qBound(1, level, 9), Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    QByteArray buffer(int(ChunkSize), Qt::Uninitialized);
+    bool ok = true;
+    auto feed = [&](const char *bytes, qint64 size, int flush) {
+        z.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(bytes));
+        z.avail_in = uInt(size);
+        int result;
+        do {
+            z.next_out = reinterpret_cast<Bytef *>(buffer.data());
+            z.avail_out = uInt(buffer.size());
+            result = deflate(&z, flush);
+            if (result == Z_STREAM_ERROR) {
+                ok = false;
+                break;
+            }
+            qint64 produced = buffer.size() - qint64(z.avail_out);
+            if (produced > 0 && out.write(buffer.constData(), produced) != produced) {
+                ok = false;
+            }
+        } while (ok && (z.avail_out == 0 || (flush == Z_FINISH && result != Z_STREAM_END)));
+    };
+
+    char header[HeaderSize];
+    quint64 indexSize = quint64(index.size());
+    quint64 dataSize = quint64(data.size());
+    std::memcpy(header, ArchiveMagic, sizeof(ArchiveMagic));
+    std::memcpy(header + 8, &indexSize, sizeof(indexSize));
+    std::memcpy(header + 16, &dataSize, sizeof(dataSize));
+    feed(header, HeaderSize, Z_NO_FLUSH);
+
+    QByteArray chunk;
+    for (QFile *file : {&index, &data}) {
+        while (ok && !(chunk = file->read(ChunkSize)).isEmpty()) {
+            feed(chunk.constData(), chunk.size(), Z_NO_FLUSH);
+            // La chiusura non aspetta la fine: il segmento resta da comprimere
+            if (isInterruptionRequested()) {
+                ok = false;
+            }
+        }
+    }
+    if (ok) {
+        feed(nullptr, 0, Z_FINISH);
+    }
+    deflateEnd(&z);
+
+    if (!ok) {
+        out.cancelWriting();
+        return false;
+    }
+    return out.commit();
+}
+
+bool LogArchiver::extract(const QString &archivePath, const QString &storeBase)
+{
+    QFile in(archivePath);
+    QFile index(storeBase + ".idx");
+    QFile data(storeBase + ".dat");
+    if (!in.open(QIODevice::ReadOnly) || !index.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        || !data.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    z_stream z;
+    std::memset(&z, 0, sizeof(z));
+    if (inflateInit2(&z, 15 + 32) != Z_OK) {
+        return false;
+    }
+
+    // I byte decompressi vanno prima nell'intestazione, poi nell'indice,
+    // poi nei dati
+    QByteArray header;
+    quint64 indexLeft = 0;
+    quint64 dataLeft = 0;
+    bool ok = true;
+    auto consume = [&](const char *bytes, qint64 size) {
+        while (ok && size > 0) {
+            qint64 taken;
+            if (header.size() < HeaderSize) {
+                taken = qMin<qint64>(size, HeaderSize - header.size());
+                header.append(bytes, int(taken));
+                if (header.size() == HeaderSize) {
+                    ok = std::memcmp(header.constData(), ArchiveMagic, sizeof(ArchiveMagic)) == 0;
+                    std::memcpy(&indexLeft, header.constData() + 8, sizeof(indexLeft));
+                    std::memcpy(&dataLeft, header.constData() + 16, sizeof(dataLeft));
+                }
+            } else if (indexLeft > 0) {
+                taken = qint64(qMin<quint64>(quint64(size), indexLeft));
+                ok = index.write(bytes, taken) == taken;
+                indexLeft -= quint64(taken);
+            } else if (dataLeft > 0) {
+                taken = qint64(qMin<quint64>(quint64(size), dataLeft));
+                ok = data.write(bytes, taken) == taken;
+                dataLeft -= quint64(taken);
+            } else {
+                ok = false;
+                break;
+            }
+            bytes += taken;
+            size -= taken;
+        }
+    };
+
+    QByteArray buffer(int(ChunkSize), Qt::Uninitialized);
+    int result = Z_OK;
+    while (ok && result != Z_STREAM_END) {
+        QByteArray chunk = in.read(ChunkSize);
+        if (chunk.isEmpty()) {
+            break;
+        }
+        z.next_in = reinterpret_cast<Bytef *>(chunk.data());
+        z.avail_in = uInt(chunk.size());
+        do {
+            z.next_out = reinterpret_cast<Bytef *>(buffer.data());
+            z.avail_out = uInt(buffer.size());
+            result = inflate(&z, Z_NO_FLUSH);
+            if (result == Z_BUF_ERROR) {
+                // Nessun progresso possibile: serve altro input
+                break;
+            }
+            if (result != Z_OK && result != Z_STREAM_END) {
+                ok = false;
+                break;
+            }
+            consume(buffer.constData(), buffer.size() - qint64(z.avail_out));
+        } while (ok && z.avail_out == 0 && result != Z_STREAM_END);
+    }
+    inflateEnd(&z);
+    return ok && result == Z_STREAM_END && header.size() == HeaderSize && indexLeft == 0 && dataLeft == 0;
+}
+
+// Cancella i segmenti piu' vecchi finche' numero e spazio occupato
+// rientrano nei limiti
+void LogArchiver::enforceRetention(const QString &storeBase, const Options &options)
+{
+    QStringList files = archives(storeBase);
+    qint64 total = 0;
+    for (const QString &file : files) {
+        total += QFileInfo(file).size();
+    }
+    while (!files.isEmpty()
+           && ((options.maxArchives > 0 && files.size() > options.maxArchives)
+               || (options.maxArchiveBytes > 0 && total > options.maxArchiveBytes))) {
+        QString oldest = files.takeFirst();
+        total -= QFileInfo(oldest).size();
+        QFile::remove(oldest);
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef LOGARCHIVER_H
+#define LOGARCHIVER_H
+
+#include <QMutex>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+// Rotazione e conservazione dello storico.
+// Quando l'archivio attivo (EventStore) supera una dimensione o un'eta'
+// i suoi record vengono spostati in un segmento numerato
+//   <base>.archive.<n>.dat/.idx
+// che un thread dedicato comprime in streaming con gzip in
+//   <base>.archive.<n>.gz
+// (intestazione, indice e dati dell'EventStore) e poi cancella. Dopo
+// ogni compressione i segmenti piu' vecchi oltre i limiti di numero e di
+// spazio vengono eliminati. L'archivio attivo resta piccolo e viene
+// mappato all'avvio; i segmenti compressi si leggono solo su richiesta
+// con extract(). Un segmento non ancora compresso alla chiusura viene
+// ripreso da resume() all'avvio successivo.
+// Lo stesso thread importa i journal dei checkpoint (checkpoint()), cosi'
+// importazione e rotazione dello stesso archivio non si sovrappongono e
+// non pesano sul thread che le chiede.
+class LogArchiver : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        qint64 maxSegmentBytes = 64 << 20;      // record dell'archivio attivo oltre cui ruotare, 0 = mai
+        int maxSegmentDays = 30;                // eta' del primo record oltre cui ruotare, 0 = mai
+        int maxArchives = 0;                    // segmenti compressi da tenere, 0 = senza limite
+        qint64 maxArchiveBytes = qint64(1) << 30; // spazio dei segmenti compressi, 0 = senza limite
+        int compressionLevel = 6;               // livello di zlib, 1-9
+    };
+
+    explicit LogArchiver(QObject *parent = nullptr);
+    ~LogArchiver();
+
+    void setOptions(const Options &options);
+
+    // Ruota l'archivio storeBase se supera i limiti e ne accoda la
+    // compressione; true se ha ruotato
+    bool rotateIfNeeded(const QString &storeBase);
+    // Accoda l'importazione di un journal ruotato in storeBase, seguita da
+    // rotateIfNeeded(); se non riesce il journal resta per loadHistory()
+    void checkpoint(const QString &storeBase, const QString &journal, quint64 sequence);
+    // Accoda i segmenti di storeBase rimasti da comprimere
+    void resume(const QString &storeBase);
+    // Termina la compressione in corso senza completarla
+    void stop();
+
+    // Segmenti compressi di storeBase, dal piu' vecchio
+    static QStringList archives(const QString &storeBase);
+    // Decomprime un segmento in <storeBase>.dat/.idx, da aprire con EventStore
+    static bool extract(const QString &archivePath, const QString &storeBase);
+
+protected:
+    void run() override;
+
+private:
+    struct Job {
+        QString storeBase;
+        QString segment;        // segmento da comprimere o journal da importare
+        quint64 sequence = 0;   // diverso da 0 per un'importazione
+    };
+
+    Options opts;
+    QMutex mutex;
+    QWaitCondition wake;
+    QList<Job> queue;
+    bool stopping;
+
+    void enqueue(const Job &job);
+    bool compress(const QString &segment, int level);
+    void enforceRetention(const QString &storeBase, const Options &options);
+    static int nextSegment(const QString &storeBase);
+};
+
+#endif // LOGARCHIVER_H
@@ -0,0 +1,274 @@
+#include "logjournal.h"
+#include "fileevent.h"
+#include "metrics.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QTextStream>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+static Histogram &writeDuration = Metrics::global().histogram(
+    "dirmon_journal_write_us", "Durata della scrittura di un blocco del journal, in microsecondi");
+static Histogram &syncDuration = Metrics::global().histogram(
+    "dirmon_journal_sync_us", "Durata di un fsync del journal, in microsecondi");
+static Histogram &queueDelay = Metrics::global().histogram(
+    "dirmon_journal_queue_ms", "Attesa in coda del record piu' vecchio di un blocco, in millisecondi");
+
+static bool isRecord(const QString &line)
+{
+    QStringList fields;
+    return splitLogRecord(line, &fields);
+}
+
+// Tronca il file dopo l'ultimo '\n', leggendo a ritroso solo la coda
+static void truncateTornRecord(const QString &path)
+{
+    QFile file(path);
+    if (file.size() == 0 || !file.open(QIODevice::ReadWrite)) {
+        return;
+    }
+    qint64 end = file.size();
+    file.seek(end - 1);
+    if (file.read(1) == "\n") {
+        return;
+    }
+    const qint64 chunk = 4096;
+    qint64 pos = end;
+    while (pos > 0) {
+        qint64 from = qMax<qint64>(0, pos - chunk);
+        file.seek(from);
+        QByteArray data = file.read(pos - from);
+        int nl = data.lastIndexOf('\n');
+        if (nl >= 0) {
+            file.resize(from + nl + 1);
+            return;
+        }
+        pos = from;
+    }
+    file.resize(0);
+}
+
+static void syncFile(QFile &file)
+{
+    file.flush();
+#ifdef Q_OS_UNIX
+    ::fsync(file.handle());
+#endif
+}
+
+LogJournal::LogJournal(const QString &path, QObject *parent)
+    : QThread(parent)
+    , filePath(path)
+    , requestedFlush(0)
+    , completedFlush(0)
+    , rotated(false)
+    , stopping(false)
+{
+    // Una scrittura interrotta (crash, disco pieno) lascia un record
+    // troncato senza '\n' in fondo: lo eliminiamo prima di leggere o accodare
+    truncateTornRecord(filePath);
+}
+
+LogJournal::~LogJournal()
+{
+    stop();
+}
+
+void LogJournal::setOptions(const Options &options)
+{
+    QMutexLocker locker(&mutex);
+    opts = options;
+    // Con 0 il thread di scrittura si sveglierebbe a ogni record o
+    // girerebbe a vuoto sull'attesa
+    opts.batchSize = qMax(1, opts.batchSize);
+    opts.flushInterval = qMax(1, opts.flushInterval);
+    wake.wakeOne();
+}
+
+QString LogJournal::path() const
+{
+    return filePath;
+}
+
+void LogJournal::append(const QString &record)
+{
+    QMutexLocker locker(&mutex);
+    if (pending.isEmpty()) {
+        oldestPending.start();
+    }
+    pending << record;
+    if (pending.size() >= opts.batchSize) {
+        wake.wakeOne();
+    }
+}
+
+void LogJournal::flush()
+{
+    QMutexLocker locker(&mutex);
+    if (!isRunning()) {
+        return;
+    }
+    quint64 ticket = ++requestedFlush;
+    wake.wakeOne();
+    while (completedFlush < ticket && isRunning()) {
+        flushed.wait(&mutex, 100);
+    }
+}
+
+bool LogJournal::rotate(const QString &target)
+{
+    QMutexLocker locker(&mutex);
+    if (!isRunning()) {
+        QFile file(filePath);
+        return file.size() > 0 && QFile::rename(filePath, target);
+    }
+    rotateTarget = target;
+    rotated = false;
+    quint64 ticket = ++requestedFlush;
+    wake.wakeOne();
+    while (completedFlush < ticket && isRunning()) {
+        flushed.wait(&mutex, 100);
+    }
+    return completedFlush >= ticket && rotated;
+}
+
+void LogJournal::stop()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        wake.wakeOne();
+    }
+    wait();
+}
+
+bool LogJournal::compact(const QString &path)
+{
+    QFile in(path);
+    if (!in.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return false;
+    }
+    // Un journal gia' ben formato non viene riscritto
+    QTextStream reader(&in);
+    bool clean = true;
+    while (clean && !reader.atEnd()) {
+        clean = isRecord(reader.readLine());
+    }
+    if (clean) {
+        return true;
+    }
+    reader.seek(0);
+
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream writer(&out);
+    while (!reader.atEnd()) {
+        QString line = reader.readLine();
+        if (isRecord(line)) {
+            writer << line << "\n";
+        }
+    }
+    writer.flush();
+    return out.commit();
+}
+
+void LogJournal::run()
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        qWarning("LogJournal: impossibile aprire %s", qPrintable(filePath));
+    }
+
+    QElapsedTimer sinceSync;
+    sinceSync.start();
+    quint64 sinceCompact = 0;
+    bool dirty = false;
+    // Il contenuto precedente non e' noto; poi solo i record scritti qui
+    // possono richiedere una compattazione
+    bool malformed = true;
+
+    QMutexLocker locker(&mutex);
+    for (;;) {
+        if (pending.size() < opts.batchSize && completedFlush == requestedFlush && !stopping) {
+            wake.wait(&mutex, opts.flushInterval);
+        }
+
+        QStringList batch;
+        batch.swap(pending);
+        if (!batch.isEmpty()) {
+            queueDelay.record(quint64(oldestPending.elapsed()));
+        }
+        quint64 flushTicket = requestedFlush;
+        QString rotateTo;
+        rotateTo.swap(rotateTarget);
+        bool last = stopping;
+        Options current = opts;
+        locker.unlock();
+
+        if (!batch.isEmpty() && file.isOpen()) {
+            QByteArray data;
+            for (const QString &record : batch) {
+                if (current.compactEvery > 0 && !malformed && !isRecord(record)) {
+                    malformed = true;
+                }
+                data += record.toUtf8();
+                data += '\n';
+            }
+            QElapsedTimer timer;
+            timer.start();
+            file.write(data);
+            file.flush();
+            writeDuration.record(quint64(timer.nsecsElapsed() / 1000));
+            dirty = true;
+            sinceCompact += batch.size();
+        }
+
+        bool syncNow = dirty && (flushTicket != completedFlush || last
+                                 || sinceSync.elapsed() >= current.syncInterval);
+        if (syncNow) {
+            QElapsedTimer timer;
+            timer.start();
+            syncFile(file);
+            syncDuration.record(quint64(timer.nsecsElapsed() / 1000));
+            dirty = false;
+            sinceSync.restart();
+        }
+
+        if (current.compactEvery > 0 && sinceCompact >= quint64(current.compactEvery)) {
+            if (malformed) {
+                file.close();
+                malformed = !compact(filePath);
+                file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+            }
+            sinceCompact = 0;
+        }
+
+        bool renamed = false;
+        if (!rotateTo.isEmpty()) {
+            file.close();
+            renamed = QFile(filePath).size() > 0 && QFile::rename(filePath, rotateTo);
+            if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+                qWarning("LogJournal: impossibile aprire %s", qPrintable(filePath));
+            }
+        }
+
+        locker.relock();
+        if (!rotateTo.isEmpty()) {
+            rotated = renamed;
+        }
+        if (flushTicket != completedFlush) {
+            completedFlush = flushTicket;
+            flushed.wakeAll();
+        }
+        if (last && pending.isEmpty()) {
+            break;
+        }
+    }
+    flushed.wakeAll();
+}
@@ -0,0 +1,64 @@
+#ifndef LOGJOURNAL_H
+#define LOGJOURNAL_H
+
+#include <QElapsedTimer>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QStringList>
+
+// Journal append-only del log degli eventi.
+// append() accoda il record e ritorna subito; un thread dedicato scrive
+// i record a blocchi in coda al file e fa fsync a intervalli regolari,
+// cosi' ogni evento costa O(1) di I/O ammortizzato.
+class LogJournal : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        int batchSize = 256;        // record che provocano una scrittura immediata, almeno 1
+        int flushInterval = 200;    // ms massimi prima di scrivere i record in coda, almeno 1
+        int syncInterval = 1000;    // ms massimi tra due fsync
+        int compactEvery = 0;       // record scritti tra due compattazioni, 0 = mai
+    };
+
+    // Ripara subito un eventuale record troncato in fondo al file
+    explicit LogJournal(const QString &path, QObject *parent = nullptr);
+    ~LogJournal();
+
+    void setOptions(const Options &options);
+    QString path() const;
+
+    void append(const QString &record);
+    // Blocca finche' i record accodati non sono scritti e sincronizzati su disco
+    void flush();
+    // Come flush(), poi rinomina il journal in target e ne apre uno vuoto;
+    // false se il journal era vuoto o la rinomina e' fallita
+    bool rotate(const QString &target);
+    void stop();
+
+    // Riscrive il journal tenendo solo i record ben formati; se lo sono
+    // gia' tutti il file non viene toccato
+    static bool compact(const QString &path);
+
+protected:
+    void run() override;
+
+private:
+    QString filePath;
+    Options opts;
+
+    QMutex mutex;
+    QWaitCondition wake;
+    QWaitCondition flushed;
+    QStringList pending;
+    QElapsedTimer oldestPending;
+    quint64 requestedFlush;
+    quint64 completedFlush;
+    QString rotateTarget;
+    bool rotated;
+    bool stopping;
+};
+
+#endif // LOGJOURNAL_H
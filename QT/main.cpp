@@ -4,6 +4,8 @@
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    QCoreApplication::setOrganizationName("DirectoryMonitor");
+    QCoreApplication::setApplicationName("DirectoryMonitor");
     MainWindow w;
     w.show();
     return a.exec();
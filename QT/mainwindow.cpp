@@ -1,12 +1,29 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "archivedialog.h"
+#include "eventfiltermodel.h"
+#include "eventmodel.h"
+#include "monitorsession.h"
+#include "statsdialog.h"
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QLocale>
+#include <QMenu>
 #include <QMessageBox>
+#include <QSettings>
+#include <QHeaderView>
+#include <QSortFilterProxyModel>
 
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
+    , session(nullptr)
+    , model(nullptr)
+    , filterModel(nullptr)
+    , proxy(nullptr)
+    , filterTimer(nullptr)
+    , statsDialog(nullptr)
 {
     ui->setupUi(this);
     QString directory = QFileDialog::getExistingDirectory(this,
@@ -17,42 +34,101 @@ MainWindow::MainWindow(QWidget *parent)
     if (directory.isEmpty()) {
         QMessageBox::warning(this, "Errore", "Nessuna cartella selezionata. Il programma verrà chiuso.");
         QTimer::singleShot(0, qApp, &QCoreApplication::quit);
+        return;
     }
 
     monitoredDir = directory;
     setWindowTitle("Monitoring: " + monitoredDir);
 
-    QFont font = ui->tableWidget->horizontalHeader()->font();
+    QSettings settings;
+
+    // La vista disegna solo le righe visibili; l'ordinamento avviene
+    // nel proxy solo quando si clicca su un'intestazione
+    model = new EventModel(this);
+    model->setCapacity(settings.value("maxRows", 0).toInt());
+    // La ricerca passa dagli indici di EventFilterModel, non dal proxy
+    filterModel = new EventFilterModel(this);
+    filterModel->setSourceModel(model);
+    proxy = new QSortFilterProxyModel(this);
+    proxy->setSourceModel(filterModel);
+    proxy->setSortRole(EventModel::SortRole);
+    proxy->setDynamicSortFilter(false);
+    ui->tableView->setModel(proxy);
+
+    QFont font = ui->tableView->horizontalHeader()->font();
     font.setBold(true);
-    ui->tableWidget->horizontalHeader()->setFont(font);
-
-    ui->tableWidget->horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
-    ui->tableWidget->horizontalHeader()->setSectionResizeMode(1, QHeaderView::Stretch);
-    ui->tableWidget->horizontalHeader()->setSectionResizeMode(2, QHeaderView::ResizeToContents);
-    ui->tableWidget->horizontalHeader()->setSectionResizeMode(3, QHeaderView::ResizeToContents);
-    ui->tableWidget->setSortingEnabled(true);
+    ui->tableView->horizontalHeader()->setFont(font);
+
+    // ResizeToContents misurerebbe tutte le righe: larghezze fisse
+    ui->tableView->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
+    ui->tableView->horizontalHeader()->setSectionResizeMode(EventModel::FileColumn, QHeaderView::Stretch);
+    ui->tableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    ui->tableView->setColumnWidth(EventModel::ColorColumn, 30);
+    ui->tableView->setColumnWidth(EventModel::EventColumn, 100);
+    ui->tableView->setColumnWidth(EventModel::TimeColumn, 200);
+    ui->tableView->setSortingEnabled(true);
+    ui->tableView->sortByColumn(-1, Qt::AscendingOrder);
 
     ui->saveLogButton->setText("Save log");
 
-    ui->tableWidget->setColumnCount(4);
-
-    QStringList intestazioni;
-    intestazioni << "Color" << "Filename" << "Event" << "Time";
-    ui->tableWidget->setHorizontalHeaderLabels(intestazioni);
-
-    ui->tableWidget->setColumnWidth(0, 30);
-    ui->tableWidget->setColumnWidth(0, 200);
-    ui->tableWidget->setColumnWidth(1, 100);
-    ui->tableWidget->setColumnWidth(2, 150);
+    // Scanner, journal e storico stanno nella sessione, condivisa con il
+    // demone senza interfaccia
+    session = new MonitorSession(this);
+    session->addRoot(monitoredDir);
+    connect(session, &MonitorSession::eventsAdded, this, &MainWindow::addEvents);
+    session->start(settings);
+    model->setHistory(session->history(0));
 
-    loadFromFile();
-
-    connect(qApp, &QApplication::aboutToQuit, this, &MainWindow::saveToFile);
     connect(ui->saveLogButton, &QPushButton::clicked, this, &MainWindow::saveToFile);
 
-    timer = new QTimer(this);
-    connect(timer, &QTimer::timeout, this, &MainWindow::checkDirectory);
-    timer->start(3000);
+    // Costi di scansioni, journal e tabella, per regolare gli intervalli
+    connect(ui->menubar->addAction("Statistiche"), &QAction::triggered, this, [this] {
+        if (!statsDialog) {
+            statsDialog = new StatsDialog(this);
+        }
+        statsDialog->show();
+        statsDialog->raise();
+        statsDialog->activateWindow();
+    });
+
+    // Segmenti compressi dello storico, aperti solo se richiesti
+    QMenu *archiveMenu = ui->menubar->addMenu("Archivi");
+    connect(archiveMenu, &QMenu::aboutToShow, this, [this, archiveMenu] {
+        archiveMenu->clear();
+        QStringList archives = session->archives(0);
+        if (archives.isEmpty()) {
+            archiveMenu->addAction("Nessun archivio")->setEnabled(false);
+        }
+        for (int i = archives.size() - 1; i >= 0; --i) {
+            QFileInfo info(archives[i]);
+            QString text = info.lastModified().toString("yyyy-MM-dd hh:mm") + "  ("
+                           + QLocale().formattedDataSize(info.size()) + ")";
+            QString path = archives[i];
+            connect(archiveMenu->addAction(text), &QAction::triggered, this, [this, path] {
+                ArchiveDialog *dialog = new ArchiveDialog(path, this);
+                dialog->setAttribute(Qt::WA_DeleteOnClose);
+                dialog->show();
+            });
+        }
+    });
+
+    ui->typeCombo->addItems(QStringList() << "Tutti" << "Created" << "Modified" << "Deleted");
+    QDateTime now = QDateTime::currentDateTime();
+    ui->fromEdit->setDateTime(now.addDays(-1));
+    ui->toEdit->setDateTime(now);
+    connect(ui->timeCheck, &QCheckBox::toggled, ui->fromEdit, &QWidget::setEnabled);
+    connect(ui->timeCheck, &QCheckBox::toggled, ui->toEdit, &QWidget::setEnabled);
+
+    // La query parte quando si smette di scrivere
+    filterTimer = new QTimer(this);
+    filterTimer->setSingleShot(true);
+    filterTimer->setInterval(150);
+    connect(filterTimer, &QTimer::timeout, this, &MainWindow::applyFilter);
+    connect(ui->filterEdit, &QLineEdit::textChanged, filterTimer, qOverload<>(&QTimer::start));
+    connect(ui->typeCombo, &QComboBox::currentIndexChanged, filterTimer, qOverload<>(&QTimer::start));
+    connect(ui->timeCheck, &QCheckBox::toggled, filterTimer, qOverload<>(&QTimer::start));
+    connect(ui->fromEdit, &QDateTimeEdit::dateTimeChanged, filterTimer, qOverload<>(&QTimer::start));
+    connect(ui->toEdit, &QDateTimeEdit::dateTimeChanged, filterTimer, qOverload<>(&QTimer::start));
 }
 
 MainWindow::~MainWindow()
@@ -61,134 +137,43 @@ MainWindow::~MainWindow()
 }
 
 
-void MainWindow::checkDirectory()
+void MainWindow::addEvents(int root, const QList<FileEvent> &events)
 {
-    QDir dir(monitoredDir);
-
-    QFile logFile(monitoredDir + "/log.txt");
-    QSet<QString> loggedFiles;
-    if (logFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QTextStream in(&logFile);
-        while (!in.atEnd()) {
-            QString line = in.readLine();
-            QStringList parts = line.split(";");
-            if (parts.size() == 4) {
-                loggedFiles.insert(parts[1]);
-            }
-        }
-        logFile.close();
-    }
-
-    QFileInfoList files = dir.entryInfoList(QDir::Files);
-    for (const QFileInfo &fileInfo : files) {
-        QString fileName = fileInfo.fileName();
-
-        if (fileName == "log.txt" || loggedFiles.contains(fileName)) {
-            continue;
-        }
-
-        QDateTime lastModified = fileInfo.lastModified();
-
-        if (!fileStatus.contains(fileName)) {
-            // Nuovo file
-            add(fileName, "Created", lastModified);
-        } else if (fileStatus[fileName] < lastModified) {
-            // File modificato
-            add(fileName, "Modified", lastModified);
-        }
-        fileStatus[fileName] = lastModified;
-    }
-
-    auto it = fileStatus.begin();
-    while (it != fileStatus.end()) {
-        if (!dir.exists(it.key())) {
-            add(it.key(), "Deleted", QDateTime::currentDateTime());
-            it = fileStatus.erase(it);
-        } else {
-            ++it;
-        }
+    Q_UNUSED(root);
+    for (const FileEvent &event : events) {
+        model->append(event.fileName, event.type, event.time.toMSecsSinceEpoch());
     }
 }
 
-
-
-void MainWindow::add(const QString &fileName, const QString &event, const QDateTime &time)
+void MainWindow::applyFilter()
 {
-    int row = ui->tableWidget->rowCount();
-    ui->tableWidget->insertRow(row);
-
-    QTableWidgetItem *colorItem = new QTableWidgetItem();
-    if (event == "Created") {
-        colorItem->setBackground(Qt::green);
-    } else if (event == "Modified") {
-        colorItem->setBackground(Qt::blue);
-    } else if (event == "Deleted") {
-        colorItem->setBackground(Qt::red);
+    EventIndex::Query query;
+    query.pattern = ui->filterEdit->text().trimmed().toStdString();
+    // Con *, ? o [ il testo e' un glob sull'intero percorso
+    query.glob = query.pattern.find_first_of("*?[") != std::string::npos;
+    static const unsigned types[] = {EventIndex::AllTypes, EventIndex::CreatedBit,
+                                     EventIndex::ModifiedBit, EventIndex::DeletedBit};
+    query.types = types[qBound(0, ui->typeCombo->currentIndex(), 3)];
+    if (ui->timeCheck->isChecked()) {
+        query.from = ui->fromEdit->dateTime().toMSecsSinceEpoch();
+        query.to = ui->toEdit->dateTime().toMSecsSinceEpoch();
     }
-    colorItem->setFlags(Qt::NoItemFlags);
-    ui->tableWidget->setItem(row, 0, colorItem);
-
-    QTableWidgetItem *fileItem = new QTableWidgetItem(fileName);
-    fileItem->setTextAlignment(Qt::AlignLeft | Qt::AlignVCenter);
-    ui->tableWidget->setItem(row, 1, fileItem);
-
-    QTableWidgetItem *eventItem = new QTableWidgetItem(event);
-    eventItem->setTextAlignment(Qt::AlignLeft | Qt::AlignVCenter);
-    ui->tableWidget->setItem(row, 2, eventItem);
-
-    QTableWidgetItem *timeItem = new QTableWidgetItem(time.toString());
-    timeItem->setTextAlignment(Qt::AlignLeft | Qt::AlignVCenter);
-    ui->tableWidget->setItem(row, 3, timeItem);
-}
-
-void MainWindow::saveToFile()
-{
-    QFile file(monitoredDir + "/log.txt");
-    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QTextStream out(&file);
-        for (int row = 0; row < ui->tableWidget->rowCount(); ++row) {
-            QString color = ui->tableWidget->item(row, 0)->background().color().name();
-            QString filename = ui->tableWidget->item(row, 1)->text();
-            QString event = ui->tableWidget->item(row, 2)->text();
-            QString time = ui->tableWidget->item(row, 3)->text();
-            out << color << ";" << filename << ";" << event << ";" << time << "\n";
-        }
-        file.close();
+    filterModel->setQuery(query);
+
+    if (query.isEmpty()) {
+        statusBar()->clearMessage();
+    } else {
+        statusBar()->showMessage(QString("%1 eventi trovati in %2 ms")
+                                     .arg(filterModel->rowCount())
+                                     .arg(filterModel->lastQueryTime()));
     }
 }
 
-void MainWindow::loadFromFile()
+// Gli eventi sono gia' accodati al journal: salvare significa solo
+// consegnare quelli in attesa e attendere che siano su disco
+void MainWindow::saveToFile()
 {
-    QFile file(monitoredDir + "/log.txt");
-    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QTextStream in(&file);
-        while (!in.atEnd()) {
-            QString line = in.readLine();
-            QStringList parts = line.split(";");
-            if (parts.size() == 4) {
-                QString fileName = parts[1];
-                if (fileName == "log.txt") {
-                    continue;
-                }
-                QTableWidgetItem *colorItem = new QTableWidgetItem();
-                colorItem->setBackground(QColor(parts[0]));
-                QTableWidgetItem *fileItem = new QTableWidgetItem(parts[1]);
-                QTableWidgetItem *eventItem = new QTableWidgetItem(parts[2]);
-                QTableWidgetItem *timeItem = new QTableWidgetItem(parts[3]);
-
-                int row = ui->tableWidget->rowCount();
-                ui->tableWidget->insertRow(row);
-                ui->tableWidget->setItem(row, 0, colorItem);
-                ui->tableWidget->setItem(row, 1, fileItem);
-                ui->tableWidget->setItem(row, 2, eventItem);
-                ui->tableWidget->setItem(row, 3, timeItem);
-            }
-        }
-        file.close();
+    if (session) {
+        session->flush();
     }
 }
-
-
-
-
-
@@ -5,8 +5,14 @@
 #include <QTimer>
 #include <QDir>
 #include <QDateTime>
-#include <QTableWidgetItem>
-#include <QMap>
+#include <QSet>
+#include "fileevent.h"
+
+class MonitorSession;
+class EventModel;
+class EventFilterModel;
+class QSortFilterProxyModel;
+class StatsDialog;
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -21,17 +27,19 @@ public:
     ~MainWindow();
 
 private slots:
-    void checkDirectory();
+    void addEvents(int root, const QList<FileEvent> &events);
+    void saveToFile();
+    void applyFilter();
 
 private:
     Ui::MainWindow *ui;
-    QTimer *timer;
+    MonitorSession *session;
+    EventModel *model;
+    EventFilterModel *filterModel;
+    QSortFilterProxyModel *proxy;
+    QTimer *filterTimer;
+    StatsDialog *statsDialog;
     QString monitoredDir;
-    QMap<QString, QDateTime> fileStatus;
-
-    void add(const QString &fileName, const QString &event, const QDateTime &time);
-    void saveToFile();
-    void loadFromFile();
 };
 
 #endif // MAINWINDOW_H
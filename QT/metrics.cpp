@@ -0,0 +1,165 @@
+#include "metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+uint64_t Histogram::Snapshot::percentile(double p) const
+{
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, uint64_t(std::ceil(p / 100.0 * double(count))));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < buckets.size(); ++b) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            return std::min(bucketUpperBound(int(b)), max);
+        }
+    }
+    return max;
+}
+
+Histogram::Histogram(const std::string &name, const std::string &help)
+    : metricName(name)
+    , metricHelp(help)
+{
+    reset();
+}
+
+int Histogram::bucketOf(uint64_t value)
+{
+    if (value < 16) {
+        return int(value);
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    int sub = int((value >> (exponent - 2)) & 3);
+    return 16 + (exponent - 4) * 4 + sub;
+}
+
+uint64_t Histogram::bucketUpperBound(int bucket)
+{
+    if (bucket < 16) {
+        return uint64_t(bucket);
+    }
+    int exponent = (bucket - 16) / 4 + 4;
+    uint64_t sub = uint64_t((bucket - 16) % 4);
+    uint64_t width = uint64_t(1) << (exponent - 2);
+    return (4 + sub) * width + width - 1;
+}
+
+void Histogram::record(uint64_t value)
+{
+    buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t current = maximum.load(std::memory_order_relaxed);
+    while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+// Le letture non sono atomiche nel loro insieme: durante una
+// registrazione count e bucket possono differire di qualche unita'
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot s;
+    s.buckets.resize(BucketCount);
+    for (int b = 0; b < BucketCount; ++b) {
+        s.buckets[size_t(b)] = buckets[b].load(std::memory_order_relaxed);
+        s.count += s.buckets[size_t(b)];
+    }
+    s.sum = sum.load(std::memory_order_relaxed);
+    s.max = maximum.load(std::memory_order_relaxed);
+    return s;
+}
+
+void Histogram::reset()
+{
+    for (std::atomic<uint64_t> &bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    sum.store(0, std::memory_order_relaxed);
+    maximum.store(0, std::memory_order_relaxed);
+}
+
+Counter::Counter(const std::string &name, const std::string &help)
+    : metricName(name)
+    , metricHelp(help)
+    , value(0)
+{
+}
+
+Metrics &Metrics::global()
+{
+    static Metrics registry;
+    return registry;
+}
+
+Histogram &Metrics::histogram(const std::string &name, const std::string &help)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const std::unique_ptr<Histogram> &h : histogramList) {
+        if (h->name() == name) {
+            return *h;
+        }
+    }
+    histogramList.emplace_back(new Histogram(name, help));
+    return *histogramList.back();
+}
+
+Counter &Metrics::counter(const std::string &name, const std::string &help)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const std::unique_ptr<Counter> &c : counterList) {
+        if (c->name() == name) {
+            return *c;
+        }
+    }
+    counterList.emplace_back(new Counter(name, help));
+    return *counterList.back();
+}
+
+std::vector<const Histogram *> Metrics::histograms() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<const Histogram *> result;
+    for (const std::unique_ptr<Histogram> &h : histogramList) {
+        result.push_back(h.get());
+    }
+    return result;
+}
+
+std::vector<const Counter *> Metrics::counters() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<const Counter *> result;
+    for (const std::unique_ptr<Counter> &c : counterList) {
+        result.push_back(c.get());
+    }
+    return result;
+}
+
+std::string Metrics::text() const
+{
+    std::string out;
+    char line[256];
+    for (const Counter *c : counters()) {
+        out += "# HELP " + c->name() + " " + c->help() + "\n";
+        out += "# TYPE " + c->name() + " counter\n";
+        std::snprintf(line, sizeof(line), "%s %llu\n", c->name().c_str(), (unsigned long long)c->get());
+        out += line;
+    }
+    static const double quantiles[] = {0.5, 0.9, 0.99, 1.0};
+    for (const Histogram *h : histograms()) {
+        Histogram::Snapshot s = h->snapshot();
+        out += "# HELP " + h->name() + " " + h->help() + "\n";
+        out += "# TYPE " + h->name() + " summary\n";
+        for (double q : quantiles) {
+            std::snprintf(line, sizeof(line), "%s{quantile=\"%g\"} %llu\n", h->name().c_str(), q,
+                          (unsigned long long)s.percentile(q * 100.0));
+            out += line;
+        }
+        std::snprintf(line, sizeof(line), "%s_sum %llu\n%s_count %llu\n", h->name().c_str(),
+                      (unsigned long long)s.sum, h->name().c_str(), (unsigned long long)s.count);
+        out += line;
+    }
+    return out;
+}
@@ -0,0 +1,95 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Metriche interne della pipeline: contatori e istogrammi con costo di
+// registrazione di poche operazioni atomiche, senza lock, usabili da
+// qualsiasi thread. Gli istogrammi hanno bucket log-lineari (quattro per
+// ogni potenza di due, esatti sotto 16): un valore e' noto con un errore
+// relativo di al piu' il 25%, che basta per percentili di latenze.
+// Le metriche si registrano una volta nel registro globale, di solito
+// in una variabile statica del file che le usa, e non vengono mai
+// rimosse.
+class Histogram
+{
+public:
+    static constexpr int BucketCount = 16 + 60 * 4;
+
+    struct Snapshot {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+        std::vector<uint64_t> buckets;
+
+        double mean() const { return count ? double(sum) / double(count) : 0.0; }
+        // Limite superiore del bucket che contiene il percentile p (0-100)
+        uint64_t percentile(double p) const;
+    };
+
+    Histogram(const std::string &name, const std::string &help);
+
+    void record(uint64_t value);
+    Snapshot snapshot() const;
+    void reset();
+
+    const std::string &name() const { return metricName; }
+    const std::string &help() const { return metricHelp; }
+
+    static int bucketOf(uint64_t value);
+    static uint64_t bucketUpperBound(int bucket);
+
+private:
+    std::string metricName;
+    std::string metricHelp;
+    std::atomic<uint64_t> buckets[BucketCount];
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> maximum;
+};
+
+class Counter
+{
+public:
+    Counter(const std::string &name, const std::string &help);
+
+    void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+    const std::string &name() const { return metricName; }
+    const std::string &help() const { return metricHelp; }
+
+private:
+    std::string metricName;
+    std::string metricHelp;
+    std::atomic<uint64_t> value;
+};
+
+class Metrics
+{
+public:
+    static Metrics &global();
+
+    // Restituisce la metrica con quel nome, creandola se manca
+    Histogram &histogram(const std::string &name, const std::string &help);
+    Counter &counter(const std::string &name, const std::string &help);
+
+    std::vector<const Histogram *> histograms() const;
+    std::vector<const Counter *> counters() const;
+
+    // Formato testuale di Prometheus: contatori e istogrammi come summary
+    // con i quantili 0.5, 0.9, 0.99 e 1
+    std::string text() const;
+
+private:
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<Histogram>> histogramList;
+    std::vector<std::unique_ptr<Counter>> counterList;
+};
+
+#endif // METRICS_H
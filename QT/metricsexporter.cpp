@@ -0,0 +1,94 @@
+#include "metricsexporter.h"
+#include "metrics.h"
+#include <QSaveFile>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+MetricsExporter::MetricsExporter(const Options &options, QObject *parent)
+    : QObject(parent)
+    , opts(options)
+    , dumpTimer(nullptr)
+    , server(nullptr)
+{
+    if (!opts.dumpFile.isEmpty() && opts.dumpInterval > 0) {
+        dumpTimer = new QTimer(this);
+        connect(dumpTimer, &QTimer::timeout, this, &MetricsExporter::dump);
+        dumpTimer->start(opts.dumpInterval);
+    }
+    if (opts.port != 0) {
+        server = new QTcpServer(this);
+        connect(server, &QTcpServer::newConnection, this, &MetricsExporter::acceptConnections);
+        if (!server->listen(QHostAddress::LocalHost, opts.port)) {
+            qWarning("MetricsExporter: impossibile ascoltare sulla porta %u: %s", unsigned(opts.port),
+                     qPrintable(server->errorString()));
+        }
+    }
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    // Ultima scrittura con i valori finali
+    if (dumpTimer) {
+        dump();
+    }
+}
+
+quint16 MetricsExporter::serverPort() const
+{
+    return server && server->isListening() ? server->serverPort() : 0;
+}
+
+void MetricsExporter::dump()
+{
+    if (opts.dumpFile.isEmpty()) {
+        return;
+    }
+    // Chi legge il file non vede mai una scrittura a meta'
+    QSaveFile file(opts.dumpFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    file.write(QByteArray::fromStdString(Metrics::global().text()));
+    file.commit();
+}
+
+void MetricsExporter::acceptConnections()
+{
+    while (QTcpSocket *socket = server->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket] { respond(socket); });
+        // Un client che non manda la richiesta non tiene aperta la connessione
+        QTimer::singleShot(5000, socket, [socket] { socket->abort(); });
+    }
+}
+
+// HTTP minimo: basta la prima riga della richiesta, le intestazioni
+// vengono ignorate
+void MetricsExporter::respond(QTcpSocket *socket)
+{
+    if (!socket->canReadLine()) {
+        if (socket->bytesAvailable() > 8192) {
+            socket->abort();
+        }
+        return;
+    }
+    disconnect(socket, &QTcpSocket::readyRead, this, nullptr);
+    QList<QByteArray> request = socket->readLine().trimmed().split(' ');
+
+    QByteArray status;
+    QByteArray body;
+    if (request.size() < 2 || request[0] != "GET") {
+        status = "405 Method Not Allowed";
+    } else if (request[1] == "/metrics" || request[1].startsWith("/metrics?")) {
+        status = "200 OK";
+        body = QByteArray::fromStdString(Metrics::global().text());
+    } else {
+        status = "404 Not Found";
+    }
+    socket->write("HTTP/1.0 " + status + "\r\n"
+                  "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                  "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                  "Connection: close\r\n\r\n" + body);
+    socket->disconnectFromHost();
+}
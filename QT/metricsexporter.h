@@ -0,0 +1,46 @@
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+
+#include <QObject>
+#include <QString>
+
+class QTcpServer;
+class QTcpSocket;
+class QTimer;
+
+// Rende visibili fuori dal processo le metriche del registro globale:
+// le riscrive periodicamente in un file (sostituito in modo atomico) e
+// le offre in formato Prometheus su http://127.0.0.1:<port>/metrics.
+// Il server ascolta solo in locale e risponde a una richiesta per
+// connessione.
+class MetricsExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        QString dumpFile;           // vuoto = nessun file
+        int dumpInterval = 10000;   // ms tra due scritture del file
+        quint16 port = 0;           // 0 = nessun server
+    };
+
+    MetricsExporter(const Options &options, QObject *parent = nullptr);
+    ~MetricsExporter();
+
+    quint16 serverPort() const;
+
+public slots:
+    void dump();
+
+private slots:
+    void acceptConnections();
+
+private:
+    Options opts;
+    QTimer *dumpTimer;
+    QTcpServer *server;
+
+    void respond(QTcpSocket *socket);
+};
+
+#endif // METRICSEXPORTER_H
@@ -0,0 +1,44 @@
+# Motore di monitoraggio senza interfaccia grafica: scanner, journal,
+# archivio dello storico e metriche. Incluso dall'applicazione, dal
+# demone dirmond e dai benchmark.
+QT += core network
+CONFIG += c++17 thread
+# Compressione dei segmenti dello storico
+LIBS += -lz
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/contenthasher.cpp \
+    $$PWD/directoryscanner.cpp \
+    $$PWD/directorywatcher.cpp \
+    $$PWD/eventcoalescer.cpp \
+    $$PWD/eventindex.cpp \
+    $$PWD/eventstore.cpp \
+    $$PWD/filetree.cpp \
+    $$PWD/logarchiver.cpp \
+    $$PWD/logjournal.cpp \
+    $$PWD/metrics.cpp \
+    $$PWD/metricsexporter.cpp \
+    $$PWD/monitorsession.cpp \
+    $$PWD/pathtrie.cpp \
+    $$PWD/scanscheduler.cpp \
+    $$PWD/workerpool.cpp
+
+HEADERS += \
+    $$PWD/contenthasher.h \
+    $$PWD/directoryscanner.h \
+    $$PWD/directorywatcher.h \
+    $$PWD/eventcoalescer.h \
+    $$PWD/eventindex.h \
+    $$PWD/eventstore.h \
+    $$PWD/fileevent.h \
+    $$PWD/filetree.h \
+    $$PWD/logarchiver.h \
+    $$PWD/logjournal.h \
+    $$PWD/metrics.h \
+    $$PWD/metricsexporter.h \
+    $$PWD/monitorsession.h \
+    $$PWD/pathtrie.h \
+    $$PWD/scanscheduler.h \
+    $$PWD/workerpool.h
@@ -0,0 +1,369 @@
+#include "monitorsession.h"
+#include "directoryscanner.h"
+#include "eventstore.h"
+#include "logarchiver.h"
+#include "logjournal.h"
+#include "metrics.h"
+#include "metricsexporter.h"
+#include "scanscheduler.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QThread>
+#include <QTimer>
+
+static Histogram &eventDelay = Metrics::global().histogram(
+    "dirmon_event_delay_ms", "Ritardo tra la modifica del file (mtime) e la consegna dell'evento, in millisecondi");
+static Counter &eventsTotal = Metrics::global().counter(
+    "dirmon_events_total", "Eventi consegnati da tutte le radici");
+
+MonitorSession::MonitorSession(QObject *parent)
+    : QObject(parent)
+    , scanThread(nullptr)
+    , scheduler(nullptr)
+    , exporter(nullptr)
+    , archiver(nullptr)
+    , checkpointEvents(0)
+{
+}
+
+MonitorSession::~MonitorSession()
+{
+    if (scanThread) {
+        scanThread->quit();
+        scanThread->wait();
+    }
+    for (Root &root : roots) {
+        if (root.journal) {
+            root.journal->stop();
+        }
+        delete root.history;
+    }
+    // Un segmento a meta' compressione viene ripreso al prossimo avvio
+    if (archiver) {
+        archiver->stop();
+    }
+}
+
+int MonitorSession::addRoot(const QString &dir, const RootOptions &options)
+{
+    Root root;
+    root.dir = dir;
+    root.options = options;
+    root.scanner = nullptr;
+    root.journal = nullptr;
+    root.history = nullptr;
+    root.journalSequence = 0;
+    root.sinceCheckpoint = 0;
+    roots.append(root);
+    return roots.size() - 1;
+}
+
+QString MonitorSession::dataDirectory(const QString &dir)
+{
+    QByteArray key = QCryptographicHash::hash(dir.toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/roots/" + QString::fromLatin1(key);
+}
+
+void MonitorSession::readRoots(QSettings &settings, QStringList *dirs, QVector<RootOptions> *options)
+{
+    int count = settings.beginReadArray("roots");
+    for (int i = 0; i < count; ++i) {
+        settings.setArrayIndex(i);
+        QString path = settings.value("path").toString();
+        if (path.isEmpty()) {
+            continue;
+        }
+        RootOptions rootOptions;
+        rootOptions.priority = settings.value("priority", rootOptions.priority).toInt();
+        rootOptions.pollInterval = settings.value("pollInterval", rootOptions.pollInterval).toInt();
+        dirs->append(path);
+        options->append(rootOptions);
+    }
+    settings.endArray();
+}
+
+void MonitorSession::start(QSettings &settings)
+{
+    LogJournal::Options journalOptions;
+    journalOptions.batchSize = settings.value("journal/batchSize", journalOptions.batchSize).toInt();
+    journalOptions.flushInterval = settings.value("journal/flushInterval", journalOptions.flushInterval).toInt();
+    journalOptions.syncInterval = settings.value("journal/syncInterval", journalOptions.syncInterval).toInt();
+    journalOptions.compactEvery = settings.value("journal/compactEvery", journalOptions.compactEvery).toInt();
+    checkpointEvents = settings.value("store/checkpointEvents", 100000).toInt();
+
+    // Rotazione dello storico: dimensioni in MiB, eta' in giorni, 0 = nessun limite
+    LogArchiver::Options archiveOptions;
+    archiveOptions.maxSegmentBytes = settings.value("log/maxSegmentMiB", 64).toLongLong() << 20;
+    archiveOptions.maxSegmentDays = settings.value("log/maxSegmentDays", archiveOptions.maxSegmentDays).toInt();
+    archiveOptions.maxArchives = settings.value("log/maxArchives", archiveOptions.maxArchives).toInt();
+    archiveOptions.maxArchiveBytes = settings.value("log/maxArchiveMiB", 1024).toLongLong() << 20;
+    archiveOptions.compressionLevel = settings.value("log/compressionLevel", archiveOptions.compressionLevel).toInt();
+    // Con log/inMonitoredDir journal e storico restano nella cartella
+    // monitorata come nelle versioni precedenti
+    bool inMonitoredDir = settings.value("log/inMonitoredDir", false).toBool();
+    archiver = new LogArchiver(this);
+    archiver->setOptions(archiveOptions);
+    archiver->start();
+
+    // hash/enabled attiva le impronte del contenuto; limiti in MiB e MiB/s
+    ContentHasher::Options hashOptions;
+    hashOptions.enabled = settings.value("hash/enabled", false).toBool();
+    hashOptions.maxFileSize = settings.value("hash/maxFileSizeMiB", 256).toULongLong() << 20;
+    hashOptions.bytesPerSecond = settings.value("hash/maxMiBPerSecond", 0).toULongLong() << 20;
+    hashOptions.threads = settings.value("hash/threads", 0).toUInt();
+    // Finestre di accorpamento in ms; coalesce/quietMs = 0 le disattiva
+    EventCoalescer::Options coalesceOptions;
+    coalesceOptions.quietMs = settings.value("coalesce/quietMs", coalesceOptions.quietMs).toLongLong();
+    coalesceOptions.maxDelayMs = settings.value("coalesce/maxDelayMs", coalesceOptions.maxDelayMs).toLongLong();
+    // scheduler/maxEntriesPerSecond limita le voci lette dai polling di tutte le radici
+    ScanScheduler::Options schedulerOptions;
+    schedulerOptions.maxEntriesPerSecond = settings.value("scheduler/maxEntriesPerSecond", 0).toLongLong();
+
+    // Watcher, polling e confronto con lo stato noto girano nel thread
+    // delle scansioni; qui arrivano solo blocchi di eventi gia' pronti
+    qRegisterMetaType<FileEvent>();
+    qRegisterMetaType<QList<FileEvent>>();
+    scanThread = new QThread(this);
+    scheduler = new ScanScheduler;
+    scheduler->setOptions(schedulerOptions);
+    int slowScanMs = settings.value("scanner/slowScanMs", 1000).toInt();
+    // Ogni quanti polling rileggere tutto anche con inotify attivo
+    int fullScanEvery = settings.value("scanner/fullScanEvery", 10).toInt();
+
+    for (int i = 0; i < roots.size(); ++i) {
+        Root &root = roots[i];
+        if (inMonitoredDir) {
+            root.journalPath = root.dir + "/log.txt";
+            root.storeBase = root.dir + "/.events";
+        } else {
+            QString dataDir = dataDirectory(root.dir);
+            QDir().mkpath(dataDir);
+            root.journalPath = dataDir + "/log.txt";
+            root.storeBase = dataDir + "/events";
+            moveLog(root, dataDir);
+        }
+        // Segmenti ruotati in un'esecuzione precedente e non ancora compressi
+        archiver->resume(root.storeBase);
+        // Il journal va creato prima di loadHistory(): ripara l'eventuale
+        // record troncato da una chiusura anomala
+        root.journal = new LogJournal(root.journalPath, this);
+        root.journal->setOptions(journalOptions);
+        // Lo storico sta in un archivio binario; log.txt contiene
+        // solo gli eventi successivi all'ultimo checkpoint
+        QSet<QString> loggedFiles = loadHistory(i);
+        root.journal->start();
+
+        root.scanner = new DirectoryScanner(root.dir);
+        root.scanner->setLoggedFiles(loggedFiles);
+        // pollInterval (ms) nelle impostazioni regola il polling di sicurezza, 0 lo disattiva
+        int pollInterval = root.options.pollInterval >= 0 ? root.options.pollInterval
+                                                          : settings.value("pollInterval", -1).toInt();
+        root.scanner->setPollInterval(pollInterval);
+        root.scanner->setBatching(settings.value("scanner/batchInterval", 16).toInt(),
+                                  settings.value("scanner/maxBatch", 2000).toInt());
+        root.scanner->setCrawlThreads(settings.value("scanner/threads", 0).toInt());
+        root.scanner->setContentHashing(hashOptions);
+        root.scanner->setCoalescing(coalesceOptions);
+        root.scanner->setSlowScanWarning(slowScanMs);
+        root.scanner->setFullScanEvery(fullScanEvery);
+        scheduler->addScanner(root.scanner, root.options.priority);
+        root.scanner->moveToThread(scanThread);
+        connect(scanThread, &QThread::finished, root.scanner, &QObject::deleteLater);
+        connect(root.scanner, &DirectoryScanner::eventsReady, this,
+                [this, i](const QList<FileEvent> &events) { addEvents(i, events); });
+    }
+
+    scheduler->moveToThread(scanThread);
+    connect(scanThread, &QThread::started, scheduler, &ScanScheduler::start);
+    connect(scanThread, &QThread::finished, scheduler, &QObject::deleteLater);
+    scanThread->start();
+
+    // metrics/dumpFile scrive le metriche ogni metrics/dumpInterval ms,
+    // metrics/port le offre su http://127.0.0.1:<port>/metrics
+    MetricsExporter::Options metricsOptions;
+    metricsOptions.dumpFile = settings.value("metrics/dumpFile").toString();
+    metricsOptions.dumpInterval = settings.value("metrics/dumpInterval", metricsOptions.dumpInterval).toInt();
+    metricsOptions.port = quint16(settings.value("metrics/port", 0).toUInt());
+    if (!metricsOptions.dumpFile.isEmpty() || metricsOptions.port != 0) {
+        exporter = new MetricsExporter(metricsOptions, this);
+    }
+
+    connect(qApp, &QCoreApplication::aboutToQuit, this, &MonitorSession::shutdown);
+}
+
+int MonitorSession::rootCount() const
+{
+    return roots.size();
+}
+
+QString MonitorSession::directory(int root) const
+{
+    return roots.at(root).dir;
+}
+
+const EventStore *MonitorSession::history(int root) const
+{
+    return roots.at(root).history;
+}
+
+QStringList MonitorSession::archives(int root) const
+{
+    return LogArchiver::archives(roots.at(root).storeBase);
+}
+
+void MonitorSession::addEvents(int index, const QList<FileEvent> &events)
+{
+    Root &root = roots[index];
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (const FileEvent &event : events) {
+        // Per le cancellazioni l'ora e' quella in cui sono state viste
+        if (event.type != EventType::Deleted) {
+            eventDelay.record(quint64(qMax<qint64>(0, now - event.time.toMSecsSinceEpoch())));
+        }
+        root.journal->append(eventColorName(event.type) + ";" + event.fileName + ";"
+                             + eventName(event.type) + ";" + event.time.toString());
+    }
+    eventsTotal.add(quint64(events.size()));
+    emit eventsAdded(index, events);
+
+    root.sinceCheckpoint += events.size();
+    if (checkpointEvents > 0 && root.sinceCheckpoint >= checkpointEvents) {
+        root.sinceCheckpoint = 0;
+        QTimer::singleShot(0, this, [this, index] { checkpointRoot(index); });
+    }
+}
+
+void MonitorSession::flush()
+{
+    if (!scanThread) {
+        return;
+    }
+    for (const Root &root : roots) {
+        QMetaObject::invokeMethod(root.scanner, &DirectoryScanner::flush, Qt::BlockingQueuedConnection);
+    }
+    // I blocchi emessi da flush() sono in coda a questo thread
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+    // Gli eventi sono gia' accodati ai journal: resta da attendere che
+    // siano scritti e sincronizzati su disco
+    for (const Root &root : roots) {
+        root.journal->flush();
+    }
+}
+
+void MonitorSession::shutdown()
+{
+    flush();
+    checkpoint();
+}
+
+void MonitorSession::checkpoint()
+{
+    for (int i = 0; i < roots.size(); ++i) {
+        checkpointRoot(i);
+    }
+}
+
+// Porta nell'archivio gli eventi del journal: il journal viene rinominato
+// in un segmento numerato, importato e poi cancellato. Il numero del
+// segmento resta nel footer dell'archivio, cosi' un segmento rimasto
+// dopo un'interruzione non viene importato due volte. L'importazione
+// riscrive l'indice dei nomi e gira nel thread del LogArchiver.
+void MonitorSession::checkpointRoot(int index)
+{
+    Root &root = roots[index];
+    if (!root.journal) {
+        return;
+    }
+    root.sinceCheckpoint = 0;
+    QString segment = rotateJournal(root);
+    // Se l'importazione fallisce il segmento resta e viene ripreso al
+    // prossimo avvio
+    if (!segment.isEmpty()) {
+        archiver->checkpoint(root.storeBase, segment, root.journalSequence);
+    }
+}
+
+// Rinomina il journal nel segmento successivo; vuoto se non c'era nulla
+QString MonitorSession::rotateJournal(Root &root)
+{
+    QString segment = root.storeBase + ".journal." + QString::number(root.journalSequence + 1);
+    if (!root.journal->rotate(segment)) {
+        return QString();
+    }
+    ++root.journalSequence;
+    return segment;
+}
+
+// Al primo avvio con la nuova posizione journal, storico e segmenti
+// lasciati nella cartella monitorata vengono spostati in dataDir
+void MonitorSession::moveLog(const Root &root, const QString &dataDir)
+{
+    if (QFile::exists(root.storeBase + ".idx") || QFile::exists(root.journalPath)) {
+        return;
+    }
+    QFile::rename(root.dir + "/log.txt", root.journalPath);
+    QFile::rename(root.dir + "/.events.dat", root.storeBase + ".dat");
+    QFile::rename(root.dir + "/.events.idx", root.storeBase + ".idx");
+    QDir dir(root.dir);
+    const QStringList segments = dir.entryList(QStringList() << ".events.journal.*", QDir::Files | QDir::Hidden);
+    for (const QString &segment : segments) {
+        QFile::rename(dir.filePath(segment), root.storeBase + segment.mid(7));
+    }
+
+    QFile marker(dataDir + "/root.txt");
+    if (marker.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        marker.write(root.dir.toUtf8() + '\n');
+    }
+}
+
+QSet<QString> MonitorSession::loadHistory(int index)
+{
+    Root &root = roots[index];
+    EventStore store(root.storeBase);
+    store.open();
+    root.journalSequence = store.journalSequence();
+    store.close();
+
+    // Segmenti lasciati da un checkpoint interrotto, in ordine
+    QDir dir = QFileInfo(root.storeBase).dir();
+    QString prefix = QFileInfo(root.storeBase).fileName() + ".journal.";
+    QMap<quint64, QString> segments;
+    const QStringList entries = dir.entryList(QStringList() << prefix + "*", QDir::Files | QDir::Hidden);
+    for (const QString &entry : entries) {
+        bool ok;
+        quint64 sequence = entry.mid(prefix.size()).toULongLong(&ok);
+        if (ok) {
+            segments.insert(sequence, dir.filePath(entry));
+        }
+    }
+    for (auto it = segments.constBegin(); it != segments.constEnd(); ++it) {
+        if (it.key() <= root.journalSequence || EventStore::importJournal(root.storeBase, it.value(), it.key())) {
+            QFile::remove(it.value());
+        }
+        root.journalSequence = qMax(root.journalSequence, it.key());
+    }
+
+    // Il journal non e' ancora partito: rotate() rinomina direttamente.
+    // Al primo avvio questo converte il vecchio log.txt testuale. Lo
+    // storico serve subito, quindi qui si importa senza passare dal
+    // LogArchiver.
+    root.sinceCheckpoint = 0;
+    QString segment = rotateJournal(root);
+    if (!segment.isEmpty() && EventStore::importJournal(root.storeBase, segment, root.journalSequence)) {
+        QFile::remove(segment);
+    }
+    // Si carica solo l'archivio attivo, che dopo una rotazione per eta'
+    // contiene solo i file presenti
+    archiver->rotateIfNeeded(root.storeBase);
+
+    root.history = new EventStore(root.storeBase);
+    root.history->open();
+    return root.history->liveFiles();
+}
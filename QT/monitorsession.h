@@ -0,0 +1,104 @@
+#ifndef MONITORSESSION_H
+#define MONITORSESSION_H
+
+#include "fileevent.h"
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class DirectoryScanner;
+class EventStore;
+class LogArchiver;
+class LogJournal;
+class MetricsExporter;
+class QSettings;
+class QThread;
+class ScanScheduler;
+
+// Monitoraggio di una o piu' cartelle senza interfaccia grafica.
+// Ogni radice ha il suo scanner, il suo journal log.txt e il suo
+// archivio dello storico con i checkpoint, ruotato in segmenti compressi
+// da un LogArchiver; tutti gli scanner condividono un solo thread e uno
+// ScanScheduler che distribuisce le scansioni. Journal e storico stanno
+// in dataDirectory(), fuori dalla cartella monitorata.
+// Chi lo usa (la finestra o il demone) riceve solo gli eventi tramite
+// eventsAdded(). In chiusura dell'applicazione consegna gli eventi
+// ancora in attesa, sincronizza i journal e fa un ultimo checkpoint.
+class MonitorSession : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct RootOptions {
+        int priority = 0;           // piu' alta = letta prima
+        int pollInterval = -1;      // ms, 0 = nessun polling, -1 = pollInterval globale
+    };
+
+    explicit MonitorSession(QObject *parent = nullptr);
+    ~MonitorSession();
+
+    // Da chiamare prima di start(); restituisce l'indice della radice
+    int addRoot(const QString &dir, const RootOptions &options = RootOptions());
+
+    // Legge le impostazioni (journal/*, store/*, log/*, scanner/*,
+    // scheduler/*, hash/*, coalesce/*, metrics/*, pollInterval) e avvia
+    // journal e scanner
+    void start(QSettings &settings);
+
+    int rootCount() const;
+    QString directory(int root) const;
+    // Storico caricato all'avvio, mappato finche' la sessione vive
+    const EventStore *history(int root) const;
+    // Segmenti compressi piu' vecchi dello storico, dal piu' vecchio;
+    // si leggono con LogArchiver::extract()
+    QStringList archives(int root) const;
+
+    // Cartella dei dati di una radice, in AppDataLocation
+    static QString dataDirectory(const QString &dir);
+
+    // Radici elencate nelle impostazioni: array "roots" con path,
+    // priority e pollInterval
+    static void readRoots(QSettings &settings, QStringList *dirs, QVector<RootOptions> *options);
+
+public slots:
+    // Consegna subito gli eventi in attesa e li scrive su disco
+    void flush();
+    void checkpoint();
+
+signals:
+    void eventsAdded(int root, const QList<FileEvent> &events);
+
+private slots:
+    void shutdown();
+
+private:
+    struct Root {
+        QString dir;
+        QString journalPath;
+        QString storeBase;
+        RootOptions options;
+        DirectoryScanner *scanner;
+        LogJournal *journal;
+        EventStore *history;
+        quint64 journalSequence;
+        int sinceCheckpoint;
+    };
+
+    QVector<Root> roots;
+    QThread *scanThread;
+    ScanScheduler *scheduler;
+    MetricsExporter *exporter;
+    LogArchiver *archiver;
+    int checkpointEvents;
+
+    void addEvents(int root, const QList<FileEvent> &events);
+    void checkpointRoot(int index);
+    QString rotateJournal(Root &root);
+    void moveLog(const Root &root, const QString &dataDir);
+    // Restituisce i file presenti nello storico, per lo scanner
+    QSet<QString> loadHistory(int index);
+};
+
+#endif // MONITORSESSION_H
@@ -0,0 +1,136 @@
+#include "pathtrie.h"
+#include <cstring>
+#include <stdexcept>
+
+PathTrie::PathTrie()
+    : table(16, None)
+{
+    // Il nodo 0 e' la cartella monitorata, con nome vuoto
+    nodes.push_back(Node{None, 0, 0});
+}
+
+size_t PathTrie::hash(uint32_t parent, const char *name, size_t len)
+{
+    // FNV-1a sul nome, mescolato con l'indice del padre
+    uint64_t h = 1469598103934665603ull ^ (uint64_t(parent) * 0x9e3779b97f4a7c15ull);
+    for (size_t i = 0; i < len; ++i) {
+        h ^= static_cast<unsigned char>(name[i]);
+        h *= 1099511628211ull;
+    }
+    return static_cast<size_t>(h ^ (h >> 29));
+}
+
+bool PathTrie::matches(uint32_t node, uint32_t parent, const char *name, size_t len) const
+{
+    const Node &n = nodes[node];
+    return n.parent == parent && n.nameLen == len
+           && std::memcmp(names.data() + n.nameOffset, name, len) == 0;
+}
+
+uint32_t PathTrie::find(uint32_t parent, const char *name, size_t len) const
+{
+    size_t mask = table.size() - 1;
+    for (size_t i = hash(parent, name, len) & mask;; i = (i + 1) & mask) {
+        uint32_t node = table[i];
+        if (node == None) {
+            return None;
+        }
+        if (matches(node, parent, name, len)) {
+            return node;
+        }
+    }
+}
+
+uint32_t PathTrie::insert(uint32_t parent, const char *name, size_t len)
+{
+    if (len > 0xffff || names.size() + len > 0xffffffffu || nodes.size() >= None) {
+        throw std::length_error("PathTrie: capacita' esaurita");
+    }
+
+    // Fattore di carico massimo 1/2
+    if ((nodes.size() + 1) * 2 > table.size()) {
+        grow();
+    }
+
+    size_t mask = table.size() - 1;
+    size_t i = hash(parent, name, len) & mask;
+    for (; table[i] != None; i = (i + 1) & mask) {
+        if (matches(table[i], parent, name, len)) {
+            return table[i];
+        }
+    }
+
+    uint32_t node = static_cast<uint32_t>(nodes.size());
+    nodes.push_back(Node{parent, static_cast<uint32_t>(names.size()), static_cast<uint16_t>(len)});
+    names.insert(names.end(), name, name + len);
+    table[i] = node;
+    return node;
+}
+
+uint32_t PathTrie::findPath(const std::string &path) const
+{
+    uint32_t node = Root;
+    size_t start = 0;
+    while (node != None && start < path.size()) {
+        size_t end = path.find('/', start);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        if (end > start) {
+            node = find(node, path.data() + start, end - start);
+        }
+        start = end + 1;
+    }
+    return node;
+}
+
+std::string PathTrie::name(uint32_t node) const
+{
+    const Node &n = nodes[node];
+    return std::string(names.data() + n.nameOffset, n.nameLen);
+}
+
+std::string PathTrie::path(uint32_t node) const
+{
+    // Prima la lunghezza, poi i nomi scritti dal fondo
+    size_t len = 0;
+    for (uint32_t n = node; n != Root; n = nodes[n].parent) {
+        len += nodes[n].nameLen + (len > 0 ? 1 : 0);
+    }
+
+    std::string result(len, '/');
+    size_t end = len;
+    for (uint32_t n = node; n != Root; n = nodes[n].parent) {
+        const Node &cur = nodes[n];
+        end -= cur.nameLen;
+        std::memcpy(&result[end], names.data() + cur.nameOffset, cur.nameLen);
+        if (end > 0) {
+            --end;
+        }
+    }
+    return result;
+}
+
+size_t PathTrie::memoryUsage() const
+{
+    return nodes.capacity() * sizeof(Node) + names.capacity()
+           + table.capacity() * sizeof(uint32_t);
+}
+
+void PathTrie::grow()
+{
+    std::vector<uint32_t> bigger(table.size() * 2, None);
+    size_t mask = bigger.size() - 1;
+    for (uint32_t node : table) {
+        if (node == None) {
+            continue;
+        }
+        const Node &n = nodes[node];
+        size_t i = hash(n.parent, names.data() + n.nameOffset, n.nameLen) & mask;
+        while (bigger[i] != None) {
+            i = (i + 1) & mask;
+        }
+        bigger[i] = node;
+    }
+    table.swap(bigger);
+}
@@ -0,0 +1,53 @@
+#ifndef PATHTRIE_H
+#define PATHTRIE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Albero compatto dei percorsi relativi alla cartella monitorata.
+// Ogni componente e' un nodo di 12 byte (padre, posizione e lunghezza del
+// nome) e i nomi sono accodati in un'unica area di caratteri, cosi' un
+// percorso non viene mai memorizzato per intero. La ricerca di un figlio
+// passa da una tabella hash a indirizzamento aperto che contiene solo
+// gli indici dei nodi. I nodi non vengono mai rimossi: un file cancellato
+// e poi ricreato riusa lo stesso nodo.
+class PathTrie
+{
+public:
+    static constexpr uint32_t None = 0xffffffffu;
+    static constexpr uint32_t Root = 0;
+
+    PathTrie();
+
+    uint32_t find(uint32_t parent, const char *name, size_t len) const;
+    // Restituisce il nodo esistente o ne crea uno nuovo
+    uint32_t insert(uint32_t parent, const char *name, size_t len);
+    // Percorso relativo con '/' come separatore, None se assente
+    uint32_t findPath(const std::string &path) const;
+
+    uint32_t parent(uint32_t node) const { return nodes[node].parent; }
+    std::string name(uint32_t node) const;
+    std::string path(uint32_t node) const;
+
+    size_t size() const { return nodes.size(); }
+    size_t memoryUsage() const;
+
+private:
+    struct Node {
+        uint32_t parent;
+        uint32_t nameOffset;
+        uint16_t nameLen;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<char> names;
+    std::vector<uint32_t> table;    // indici dei nodi, None = slot libero
+
+    static size_t hash(uint32_t parent, const char *name, size_t len);
+    bool matches(uint32_t node, uint32_t parent, const char *name, size_t len) const;
+    void grow();
+};
+
+#endif // PATHTRIE_H
@@ -0,0 +1,134 @@
+#include "scanscheduler.h"
+#include "directoryscanner.h"
+#include <QTimer>
+
+ScanScheduler::ScanScheduler(QObject *parent)
+    : QObject(parent)
+    , tickTimer(nullptr)
+    , lastRefill(0)
+    , tokens(0)
+{
+}
+
+void ScanScheduler::setOptions(const Options &options)
+{
+    opts = options;
+    // Con 1 ms meta' giro varrebbe 0 e nessuna radice verrebbe letta
+    opts.tickMs = qMax(2, opts.tickMs);
+}
+
+void ScanScheduler::addScanner(DirectoryScanner *scanner, int priority)
+{
+    roots.append(Root{scanner, priority, 0, 0, false});
+    scanner->setScheduler(this);
+}
+
+void ScanScheduler::setInterval(DirectoryScanner *scanner, int ms)
+{
+    for (int i = 0; i < roots.size(); ++i) {
+        Root &root = roots[i];
+        if (root.scanner != scanner || root.interval == ms) {
+            continue;
+        }
+        qint64 now = clock.elapsed();
+        if (root.interval == 0 && ms > 0) {
+            // Prima scadenza sfalsata in base alla posizione della radice
+            root.due = now + qint64(ms) * (i + 1) / roots.size();
+        } else {
+            root.due = qMin(root.due, now + ms);
+        }
+        root.interval = ms;
+        return;
+    }
+}
+
+// Eseguito nel thread delle scansioni
+void ScanScheduler::start()
+{
+    clock.start();
+    lastRefill = 0;
+    tokens = double(opts.maxEntriesPerSecond);
+
+    tickTimer = new QTimer(this);
+    tickTimer->setInterval(opts.tickMs);
+    connect(tickTimer, &QTimer::timeout, this, &ScanScheduler::tick);
+    tickTimer->start();
+    tick();
+}
+
+void ScanScheduler::refill(qint64 now)
+{
+    if (opts.maxEntriesPerSecond <= 0) {
+        return;
+    }
+    tokens += double(now - lastRefill) * double(opts.maxEntriesPerSecond) / 1000.0;
+    // Al piu' un secondo di credito accumulato
+    tokens = qMin(tokens, double(opts.maxEntriesPerSecond));
+    lastRefill = now;
+}
+
+// Radice da leggere adesso: prima quelle mai lette, poi per priorita'
+// e per scadenza; -1 se nessuna e' in attesa
+int ScanScheduler::next(qint64 now) const
+{
+    int best = -1;
+    for (int i = 0; i < roots.size(); ++i) {
+        const Root &root = roots[i];
+        if (root.started && (root.interval <= 0 || root.due > now)) {
+            continue;
+        }
+        if (best < 0) {
+            best = i;
+            continue;
+        }
+        const Root &other = roots[best];
+        if (root.started != other.started) {
+            if (!root.started) {
+                best = i;
+            }
+        } else if (root.priority != other.priority) {
+            if (root.priority > other.priority) {
+                best = i;
+            }
+        } else if (root.due < other.due) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+// A ogni giro si leggono radici finche' ce ne sono in scadenza, per al
+// piu' meta' del giro, e finche' restano gettoni
+void ScanScheduler::tick()
+{
+    QElapsedTimer slice;
+    slice.start();
+    while (slice.elapsed() < opts.tickMs / 2) {
+        qint64 now = clock.elapsed();
+        refill(now);
+        if (opts.maxEntriesPerSecond > 0 && tokens <= 0) {
+            return;
+        }
+        int index = next(now);
+        if (index < 0) {
+            return;
+        }
+
+        // Lo scanner puo' chiamare setInterval(): niente riferimenti a
+        // roots durante la scansione
+        DirectoryScanner *scanner = roots[index].scanner;
+        if (!roots[index].started) {
+            // La prima scadenza la fissa setInterval(), sfalsata
+            roots[index].started = true;
+            scanner->start();
+        } else {
+            scanner->checkDirectory();
+            roots[index].due = clock.elapsed() + roots[index].interval;
+        }
+        // Solo le voci lette davvero: un polling che salta le cartelle
+        // invariate costa poco anche su un albero grande
+        if (opts.maxEntriesPerSecond > 0) {
+            tokens -= double(scanner->lastCrawlEntries());
+        }
+    }
+}
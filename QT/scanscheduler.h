@@ -0,0 +1,69 @@
+#ifndef SCANSCHEDULER_H
+#define SCANSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QVector>
+
+class DirectoryScanner;
+class QTimer;
+
+// Pianifica le scansioni complete di piu' radici monitorate.
+// Tutti gli scanner vivono nello stesso thread dello scheduler: le
+// scansioni non si sovrappongono mai e ognuna usa i thread del gruppo
+// WorkerPool del processo, creati una volta sola e condivisi da tutte le
+// radici e dalle impronte. Ogni radice ha una priorita' e un
+// intervallo di polling; le prime scansioni e i polling successivi
+// partono uno alla volta, prima le radici con priorita' piu' alta, e
+// le scadenze iniziali sono sfalsate sull'intervallo, cosi' le radici
+// non vengono rilette tutte nello stesso momento. Con
+// maxEntriesPerSecond le voci lette (file e cartelle) da tutte le radici
+// sono limitate a un secchiello di gettoni: una scansione grande lascia
+// un debito che le successive attendono di ripagare. Gli eventi di
+// inotify restano immediati, perche' toccano poche voci.
+class ScanScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        qint64 maxEntriesPerSecond = 0;     // 0 = nessun limite
+        int tickMs = 100;
+    };
+
+    explicit ScanScheduler(QObject *parent = nullptr);
+
+    void setOptions(const Options &options);
+    // Da chiamare prima di start(), con scanner e scheduler nello
+    // stesso thread
+    void addScanner(DirectoryScanner *scanner, int priority);
+    // Chiamato dallo scanner: intervallo di polling in ms, 0 = nessuno
+    void setInterval(DirectoryScanner *scanner, int ms);
+
+public slots:
+    void start();
+
+private slots:
+    void tick();
+
+private:
+    struct Root {
+        DirectoryScanner *scanner;
+        int priority;
+        int interval;
+        qint64 due;         // ms di clock
+        bool started;
+    };
+
+    Options opts;
+    QVector<Root> roots;
+    QTimer *tickTimer;
+    QElapsedTimer clock;
+    qint64 lastRefill;
+    double tokens;
+
+    int next(qint64 now) const;
+    void refill(qint64 now);
+};
+
+#endif // SCANSCHEDULER_H
@@ -0,0 +1,93 @@
+#include "statsdialog.h"
+#include "metrics.h"
+#include <QDialogButtonBox>
+#include <QHeaderView>
+#include <QTableWidget>
+#include <QTimer>
+#include <QVBoxLayout>
+
+enum { NameColumn, CountColumn, MeanColumn, P50Column, P90Column, P99Column, MaxColumn, ColumnCount };
+
+StatsDialog::StatsDialog(QWidget *parent)
+    : QDialog(parent)
+{
+    setWindowTitle("Statistiche");
+    resize(900, 420);
+
+    table = new QTableWidget(0, ColumnCount, this);
+    table->setHorizontalHeaderLabels(QStringList() << "Metrica" << "Campioni" << "Media"
+                                                   << "p50" << "p90" << "p99" << "Max");
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->verticalHeader()->hide();
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    table->horizontalHeader()->setSectionResizeMode(NameColumn, QHeaderView::Stretch);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(table);
+    layout->addWidget(buttons);
+
+    refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(1000);
+    connect(refreshTimer, &QTimer::timeout, this, &StatsDialog::refresh);
+}
+
+void StatsDialog::showEvent(QShowEvent *event)
+{
+    refresh();
+    refreshTimer->start();
+    QDialog::showEvent(event);
+}
+
+void StatsDialog::hideEvent(QHideEvent *event)
+{
+    refreshTimer->stop();
+    QDialog::hideEvent(event);
+}
+
+static void setCell(QTableWidget *table, int row, int column, const QString &text)
+{
+    QTableWidgetItem *item = table->item(row, column);
+    if (!item) {
+        item = new QTableWidgetItem;
+        if (column != NameColumn) {
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        }
+        table->setItem(row, column, item);
+    }
+    item->setText(text);
+}
+
+void StatsDialog::refresh()
+{
+    const std::vector<const Histogram *> histograms = Metrics::global().histograms();
+    const std::vector<const Counter *> counters = Metrics::global().counters();
+    table->setRowCount(int(histograms.size() + counters.size()));
+
+    // Le righe restano nello stesso ordine: il registro non rimuove mai
+    int row = 0;
+    for (const Histogram *histogram : histograms) {
+        Histogram::Snapshot s = histogram->snapshot();
+        setCell(table, row, NameColumn, QString::fromStdString(histogram->name()));
+        table->item(row, NameColumn)->setToolTip(QString::fromStdString(histogram->help()));
+        setCell(table, row, CountColumn, QString::number(s.count));
+        setCell(table, row, MeanColumn, QString::number(s.mean(), 'f', 1));
+        setCell(table, row, P50Column, QString::number(s.percentile(50)));
+        setCell(table, row, P90Column, QString::number(s.percentile(90)));
+        setCell(table, row, P99Column, QString::number(s.percentile(99)));
+        setCell(table, row, MaxColumn, QString::number(s.max));
+        ++row;
+    }
+    for (const Counter *counter : counters) {
+        setCell(table, row, NameColumn, QString::fromStdString(counter->name()));
+        table->item(row, NameColumn)->setToolTip(QString::fromStdString(counter->help()));
+        setCell(table, row, CountColumn, QString::number(counter->get()));
+        for (int column = MeanColumn; column < ColumnCount; ++column) {
+            setCell(table, row, column, QString());
+        }
+        ++row;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef STATSDIALOG_H
+#define STATSDIALOG_H
+
+#include <QDialog>
+
+class QTableWidget;
+class QTimer;
+
+// Finestra non modale con le metriche del registro globale: per ogni
+// istogramma campioni, media, percentili e massimo, per ogni contatore
+// il valore. Si aggiorna ogni secondo finche' e' visibile.
+class StatsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit StatsDialog(QWidget *parent = nullptr);
+
+public slots:
+    void refresh();
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private:
+    QTableWidget *table;
+    QTimer *refreshTimer;
+};
+
+#endif // STATSDIALOG_H
@@ -0,0 +1,15 @@
+# Test della ricerca negli eventi: usa solo la libreria standard
+TEMPLATE = app
+CONFIG += console c++17 thread
+CONFIG -= app_bundle qt
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    main.cpp \
+    ../../eventindex.cpp \
+    ../../workerpool.cpp
+
+HEADERS += \
+    ../../eventindex.h \
+    ../../workerpool.h
@@ -0,0 +1,83 @@
+// Test di EventIndex: confronto dei glob e query sui nomi.
+
+#include "eventindex.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Il pattern sta in un buffer della sua lunghezza esatta, cosi' una
+// lettura oltre il terminatore viene segnalata da ASan
+static bool match(const std::string &pattern, const char *text)
+{
+    std::unique_ptr<char[]> copy(new char[pattern.size() + 1]);
+    std::memcpy(copy.get(), pattern.c_str(), pattern.size() + 1);
+    return EventIndex::globMatch(copy.get(), text);
+}
+
+void test_glob(){
+    assert(match("*.txt", "a/b.txt"));
+    assert(!match("*.txt", "a/b.txb"));
+    assert(match("f?le", "file"));
+    assert(match("[a-c]x", "bx"));
+    assert(!match("[!a-c]x", "bx"));
+    assert(match("[]]", "]"));
+}
+
+void test_glob_classe_aperta(){
+    // '[' senza chiusura e' un carattere come gli altri
+    assert(match("[", "["));
+    assert(!match("[", "a"));
+    assert(match("[!", "[!"));
+    assert(match("[^", "[^"));
+    assert(match("a[", "a["));
+    assert(match("*[", "x["));
+    assert(match("[ab", "[ab"));
+    assert(!match("[!", "a"));
+}
+
+void test_query(){
+    EventIndex index;
+    index.append(index.addName("Documenti/Nota[1].txt"), 0, 1000);
+    index.append(index.addName("foto.jpg"), 1, 2000);
+
+    EventIndex::Query query;
+    query.pattern = "[";
+    EventIndex::Filter filter = index.compile(query);
+    assert(index.find(filter).size() == 1);
+
+    query.glob = true;
+    query.pattern = "*[";
+    filter = index.compile(query);
+    assert(index.find(filter).empty());
+}
+
+void test_scan(){
+    // Abbastanza righe da dividere la scansione tra piu' thread
+    EventIndex index;
+    uint32_t a = index.addName("a.txt");
+    uint32_t b = index.addName("b.txt");
+    const uint32_t n = 3u << 20;
+    for (uint32_t row = 0; row < n; ++row) {
+        index.append(row % 2 ? a : b, row % 3, int64_t(row));
+    }
+    EventIndex::Query query;
+    query.types = EventIndex::ModifiedBit;
+    EventIndex::Filter filter = index.compile(query);
+    std::vector<uint32_t> rows = index.find(filter);
+    assert(rows.size() == n / 3);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        assert(rows[i] == 3 * i + 1);
+    }
+}
+
+int main(){
+    test_glob();
+    test_glob_classe_aperta();
+    test_query();
+    test_scan();
+    std::cout << "eventindextest: ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "workerpool.h"
+#include <algorithm>
+
+WorkerPool &WorkerPool::global()
+{
+    static WorkerPool pool;
+    return pool;
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (std::thread &t : threads) {
+        t.join();
+    }
+}
+
+void WorkerPool::run(unsigned parallelism, const std::function<void()> &task)
+{
+    if (parallelism <= 1) {
+        task();
+        return;
+    }
+
+    auto region = std::make_shared<Region>();
+    region->task = &task;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (threads.size() < parallelism - 1) {
+            threads.emplace_back(&WorkerPool::worker, this);
+        }
+        for (unsigned i = 1; i < parallelism; ++i) {
+            queue.push_back(region);
+        }
+    }
+    ready.notify_all();
+
+    task();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    queue.erase(std::remove(queue.begin(), queue.end(), region), queue.end());
+    done.wait(lock, [&region] { return region->running == 0; });
+}
+
+size_t WorkerPool::threadCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return threads.size();
+}
+
+void WorkerPool::worker()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        ready.wait(lock, [this] { return !queue.empty() || stopping; });
+        if (stopping) {
+            return;
+        }
+        std::shared_ptr<Region> region = std::move(queue.front());
+        queue.pop_front();
+        ++region->running;
+        lock.unlock();
+
+        (*region->task)();
+
+        lock.lock();
+        if (--region->running == 0) {
+            done.notify_all();
+        }
+    }
+}
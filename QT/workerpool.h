@@ -0,0 +1,50 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Thread di lavoro condivisi da tutto il processo.
+// run() esegue lo stesso compito su piu' thread insieme: il chiamante ne
+// esegue una copia, le altre vanno ai thread del gruppo, che vengono
+// creati alla prima richiesta e restano in vita fino alla chiusura. Il
+// compito deve prendere il lavoro da una coda condivisa e tornare quando
+// e' finita: le copie non ancora partite quando il chiamante ha finito
+// la sua vengono scartate, cosi' un gruppo occupato da un'altra
+// richiesta non la rallenta.
+class WorkerPool
+{
+public:
+    static WorkerPool &global();
+
+    ~WorkerPool();
+
+    // Esegue task su al piu' parallelism thread, chiamante compreso, e
+    // torna quando tutte le copie partite sono terminate
+    void run(unsigned parallelism, const std::function<void()> &task);
+
+    size_t threadCount() const;
+
+private:
+    struct Region {
+        const std::function<void()> *task;
+        unsigned running = 0;
+    };
+
+    mutable std::mutex mutex;
+    std::condition_variable ready;
+    std::condition_variable done;
+    std::deque<std::shared_ptr<Region>> queue;
+    std::vector<std::thread> threads;
+    bool stopping = false;
+
+    WorkerPool() = default;
+    void worker();
+};
+
+#endif // WORKERPOOL_H
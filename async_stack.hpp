@@ -0,0 +1,615 @@
+/**
+  @file async_stack.hpp
+
+  @brief File header degli stack asincroni basati su coroutine C++20
+
+  File di dichiarazioni/definizioni di AsyncStack e BoundedAsyncStack.
+  Le operazioni che non possono essere completate subito (pop su stack
+  vuoto, push su stack limitato pieno) restituiscono un awaitable che
+  sospende la coroutine chiamante finche' l'operazione non e' possibile.
+  Le coroutine sospese vengono riprese dallo stesso EventLoop, senza
+  passaggi tra thread. Richiede C++20.
+*/
+
+#ifndef ASYNC_STACK_HPP
+#define ASYNC_STACK_HPP
+#include "stack.hpp"
+#include <coroutine>
+#include <deque>
+#include <vector>
+#include <optional>
+#include <stop_token>
+#include <stdexcept>
+#include <exception> // std::terminate
+#include <utility>   // std::move, std::exchange
+
+/**
+  @brief Eccezione lanciata da un'attesa annullata
+*/
+
+class AsyncStackCancelled : public std::runtime_error {
+public:
+    AsyncStackCancelled() : std::runtime_error("Attesa sullo stack annullata") {}
+};
+
+/**
+  @brief Executor minimale a singolo thread
+
+  Mantiene una coda di coroutine pronte e le riprende in ordine FIFO.
+  E' pensato per i test e per i benchmark: un event loop reale deve
+  solo fornire un metodo post() con la stessa semantica.
+*/
+
+class EventLoop {
+
+private:
+
+    std::deque<std::coroutine_handle<> > _ready; ///<coroutine pronte per essere riprese
+
+public:
+
+    /**
+      Accoda una coroutine da riprendere
+
+      @param h coroutine da riprendere
+    */
+
+    void post(std::coroutine_handle<> h) {
+        _ready.push_back(h);
+    }
+
+    /**
+      Riprende la prima coroutine pronta
+
+      @return false se non c'erano coroutine pronte
+    */
+
+    bool runOne() {
+        if(_ready.empty())
+            return false;
+        std::coroutine_handle<> h = _ready.front();
+        _ready.pop_front();
+        h.resume();
+        return true;
+    }
+
+    /**
+      Esegue finche' ci sono coroutine pronte
+    */
+
+    void run() {
+        while(runOne()) {}
+    }
+
+    /**
+      Funzione che ritorna il numero di coroutine pronte
+
+      @return numero di coroutine in coda
+    */
+
+    std::size_t pending() const {
+        return _ready.size();
+    }
+};
+
+/**
+  @brief Coroutine senza valore di ritorno
+
+  La coroutine parte sospesa e viene avviata da Task::spawn();
+  il frame si distrugge da solo al termine. Un'eccezione non gestita
+  nel corpo della coroutine termina il programma.
+*/
+
+class Task {
+
+public:
+
+    struct promise_type {
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    Task(Task &&other) noexcept : _h(std::exchange(other._h, nullptr)) {}
+
+    ~Task() {
+        if(_h)
+            _h.destroy();
+    }
+
+    /**
+      Avvia la coroutine accodandola all'executor
+
+      @param loop executor su cui eseguire la coroutine
+    */
+
+    void spawn(EventLoop &loop) {
+        loop.post(std::exchange(_h, nullptr));
+    }
+
+private:
+
+    std::coroutine_handle<promise_type> _h; ///<frame della coroutine non ancora avviata
+
+    explicit Task(std::coroutine_handle<promise_type> h) : _h(h) {}
+
+    Task(const Task &);
+    Task &operator=(const Task &);
+};
+
+/**
+  @brief Coda intrusiva di coroutine in attesa
+
+  I nodi vivono negli awaitable, quindi nel frame della coroutine
+  sospesa: accodare e rimuovere un'attesa non alloca memoria.
+  Le attese vengono servite in ordine FIFO.
+*/
+
+template <typename T>
+class AsyncWaitList {
+
+public:
+
+    /**
+      @brief Nodo di attesa
+    */
+
+    struct Waiter {
+        std::coroutine_handle<> handle; ///<coroutine sospesa
+        std::optional<T> value;         ///<valore consegnato o da consegnare
+        bool cancelled;                 ///<true se l'attesa e' stata annullata
+        bool linked;                    ///<true se il nodo e' ancora in coda
+        Waiter *prev;
+        Waiter *next;
+
+        Waiter() : cancelled(false), linked(false), prev(nullptr), next(nullptr) {}
+    };
+
+    AsyncWaitList() : _head(nullptr), _tail(nullptr) {}
+
+    bool empty() const {
+        return _head == nullptr;
+    }
+
+    void enqueue(Waiter *w) {
+        w->prev = _tail;
+        w->next = nullptr;
+        w->linked = true;
+        if(_tail)
+            _tail->next = w;
+        else
+            _head = w;
+        _tail = w;
+    }
+
+    void remove(Waiter *w) {
+        if(w->prev)
+            w->prev->next = w->next;
+        else
+            _head = w->next;
+        if(w->next)
+            w->next->prev = w->prev;
+        else
+            _tail = w->prev;
+        w->prev = w->next = nullptr;
+        w->linked = false;
+    }
+
+    Waiter *dequeue() {
+        Waiter *w = _head;
+        if(w)
+            remove(w);
+        return w;
+    }
+
+    /**
+      Annulla tutte le attese accodando le coroutine sull'executor
+
+      @param loop executor su cui riprendere le coroutine
+    */
+
+    void cancelAll(EventLoop &loop) {
+        while(Waiter *w = dequeue()){
+            w->cancelled = true;
+            loop.post(w->handle);
+        }
+    }
+
+private:
+
+    Waiter *_head; ///<prima attesa in coda
+    Waiter *_tail; ///<ultima attesa in coda
+};
+
+/**
+  @brief Awaitable di attesa annullabile
+
+  Base comune agli awaitable di AsyncStack e BoundedAsyncStack: accoda
+  il nodo di attesa e, se lo stop_token lo consente, registra una
+  callback che rimuove il nodo e riprende la coroutine con errore.
+*/
+
+template <typename T>
+class CancellableWait {
+
+protected:
+
+    typedef typename AsyncWaitList<T>::Waiter Waiter;
+
+    struct OnStop {
+        CancellableWait *self;
+        void operator()() const {
+            if(self->_node.linked){
+                self->_list->remove(&self->_node);
+                self->_node.cancelled = true;
+                self->_loop->post(self->_node.handle);
+            }
+        }
+    };
+
+    AsyncWaitList<T> *_list;
+    EventLoop *_loop;
+    std::stop_token _token;
+    Waiter _node;
+    std::optional<std::stop_callback<OnStop> > _onStop;
+
+    CancellableWait(AsyncWaitList<T> *list, EventLoop *loop, std::stop_token token)
+        : _list(list), _loop(loop), _token(std::move(token)) {}
+
+    void suspendOn(std::coroutine_handle<> h) {
+        _node.handle = h;
+        _list->enqueue(&_node);
+        if(_token.stop_possible())
+            _onStop.emplace(_token, OnStop{this});
+    }
+
+    // Da chiamare in await_resume: rimuove la callback e segnala l'annullamento
+    void checkCancelled() {
+        _onStop.reset();
+        if(_node.cancelled)
+            throw AsyncStackCancelled();
+    }
+
+    CancellableWait(const CancellableWait &);
+    CancellableWait &operator=(const CancellableWait &);
+};
+
+/**
+  @brief Stack asincrono illimitato
+
+  push() non blocca mai; pop() restituisce un awaitable che sospende
+  la coroutine se lo stack e' vuoto. Un elemento inserito mentre ci
+  sono coroutine in attesa viene consegnato direttamente alla prima
+  di esse, che viene accodata sull'EventLoop.
+*/
+
+template <typename T>
+class AsyncStack {
+
+private:
+
+    std::vector<T> _items;        ///<elementi disponibili, la cima e' in fondo
+    AsyncWaitList<T> _poppers;    ///<coroutine in attesa di un elemento
+    EventLoop &_loop;             ///<executor su cui riprendere le coroutine
+
+    AsyncStack(const AsyncStack &);
+    AsyncStack &operator=(const AsyncStack &);
+
+public:
+
+    /**
+      @brief Awaitable restituito da pop()
+    */
+
+    class PopAwaiter : public CancellableWait<T> {
+        friend class AsyncStack;
+        AsyncStack *_stack;
+        PopAwaiter(AsyncStack *stack, std::stop_token token)
+            : CancellableWait<T>(&stack->_poppers, &stack->_loop, std::move(token)), _stack(stack) {}
+    public:
+        bool await_ready() const noexcept {
+            return !_stack->_items.empty() || this->_token.stop_requested();
+        }
+        void await_suspend(std::coroutine_handle<> h) {
+            this->suspendOn(h);
+        }
+        T await_resume() {
+            this->checkCancelled();
+            // Elemento consegnato direttamente da push()
+            if(this->_node.value)
+                return std::move(*this->_node.value);
+            if(this->_token.stop_requested())
+                throw AsyncStackCancelled();
+            T v = std::move(_stack->_items.back());
+            _stack->_items.pop_back();
+            return v;
+        }
+    };
+
+    /**
+      Costruttore parametrico
+      @param loop executor su cui riprendere le coroutine sospese
+    */
+
+    explicit AsyncStack(EventLoop &loop) : _loop(loop) {}
+
+    /**
+      Distruttore: le attese ancora pendenti vengono annullate
+    */
+
+    ~AsyncStack() {
+        _poppers.cancelAll(_loop);
+    }
+
+    /**
+      Aggiunge un elemento nella cima dello stack o lo consegna
+      alla prima coroutine in attesa
+
+      @param value valore da inserire
+    */
+
+    void push(T value) {
+        if(typename AsyncWaitList<T>::Waiter *w = _poppers.dequeue()){
+            w->value.emplace(std::move(value));
+            _loop.post(w->handle);
+        } else {
+            _items.push_back(std::move(value));
+        }
+    }
+
+    /**
+      Rimuove l'elemento in cima, sospendendo la coroutine se lo stack e' vuoto
+
+      @param token token per annullare l'attesa
+
+      @return awaitable che produce il valore rimosso
+
+      @throw AsyncStackCancelled se l'attesa viene annullata
+    */
+
+    PopAwaiter pop(std::stop_token token = std::stop_token()) {
+        return PopAwaiter(this, std::move(token));
+    }
+
+    /**
+      Rimuove l'elemento in cima senza attendere
+
+      @param out valore rimosso
+
+      @return false se lo stack e' vuoto
+    */
+
+    bool tryPop(T &out) {
+        if(_items.empty())
+            return false;
+        out = std::move(_items.back());
+        _items.pop_back();
+        return true;
+    }
+
+    /**
+      Annulla tutte le pop in attesa
+    */
+
+    void cancelAll() {
+        _poppers.cancelAll(_loop);
+    }
+
+    bool stackEmpty() const {
+        return _items.empty();
+    }
+
+    std::size_t size() const {
+        return _items.size();
+    }
+};
+
+/**
+  @brief Stack asincrono limitato
+
+  Gli elementi sono memorizzati in uno Stack di capacita' fissa.
+  Anche push() e' un awaitable: se lo stack e' pieno la coroutine
+  viene sospesa finche' una pop non libera spazio.
+*/
+
+template <typename T>
+class BoundedAsyncStack {
+
+private:
+
+    Stack<T> _items;              ///<elementi disponibili
+    unsigned int _count;          ///<numero di elementi presenti
+    AsyncWaitList<T> _poppers;    ///<coroutine in attesa di un elemento
+    AsyncWaitList<T> _pushers;    ///<coroutine in attesa di spazio, con il valore da inserire
+    EventLoop &_loop;             ///<executor su cui riprendere le coroutine
+
+    BoundedAsyncStack(const BoundedAsyncStack &);
+    BoundedAsyncStack &operator=(const BoundedAsyncStack &);
+
+    static unsigned int checkedCapacity(unsigned int capacity) {
+        if(capacity == 0)
+            throw std::invalid_argument("Capacita' nulla");
+        return capacity;
+    }
+
+    // Estrae l'elemento in cima e, se c'e' spazio, sblocca la prima push in attesa
+    T take() {
+        T v = _items.pop();
+        --_count;
+        if(typename AsyncWaitList<T>::Waiter *w = _pushers.dequeue()){
+            _items.push(std::move(*w->value));
+            ++_count;
+            w->value.reset();
+            _loop.post(w->handle);
+        }
+        return v;
+    }
+
+public:
+
+    /**
+      @brief Awaitable restituito da pop()
+    */
+
+    class PopAwaiter : public CancellableWait<T> {
+        friend class BoundedAsyncStack;
+        BoundedAsyncStack *_stack;
+        PopAwaiter(BoundedAsyncStack *stack, std::stop_token token)
+            : CancellableWait<T>(&stack->_poppers, &stack->_loop, std::move(token)), _stack(stack) {}
+    public:
+        bool await_ready() const noexcept {
+            return _stack->_count > 0 || this->_token.stop_requested();
+        }
+        void await_suspend(std::coroutine_handle<> h) {
+            this->suspendOn(h);
+        }
+        T await_resume() {
+            this->checkCancelled();
+            // Elemento consegnato direttamente da offer()
+            if(this->_node.value)
+                return std::move(*this->_node.value);
+            if(this->_token.stop_requested())
+                throw AsyncStackCancelled();
+            return _stack->take();
+        }
+    };
+
+    /**
+      @brief Awaitable restituito da push()
+    */
+
+    class PushAwaiter : public CancellableWait<T> {
+        friend class BoundedAsyncStack;
+        BoundedAsyncStack *_stack;
+        PushAwaiter(BoundedAsyncStack *stack, T value, std::stop_token token)
+            : CancellableWait<T>(&stack->_pushers, &stack->_loop, std::move(token)), _stack(stack) {
+            this->_node.value.emplace(std::move(value));
+        }
+    public:
+        bool await_ready() const noexcept {
+            return !_stack->_poppers.empty() || _stack->_count < _stack->capacity() ||
+                   this->_token.stop_requested();
+        }
+        void await_suspend(std::coroutine_handle<> h) {
+            this->suspendOn(h);
+        }
+        void await_resume() {
+            // Il valore e' gia' stato inserito da take()
+            this->checkCancelled();
+            if(!this->_node.value)
+                return;
+            if(this->_token.stop_requested())
+                throw AsyncStackCancelled();
+            if(!_stack->offer(std::move(*this->_node.value)))
+                throw std::overflow_error("Stack asincrono pieno");
+        }
+    };
+
+    /**
+      Costruttore parametrico
+      @param loop executor su cui riprendere le coroutine sospese
+      @param capacity numero massimo di elementi nello stack, almeno 1
+
+      @throw std::invalid_argument capacita' nulla: pop() non vedrebbe mai
+             le push sospese e le due coroutine resterebbero bloccate
+      @throw std::bad_alloc possibile eccezione di allocazione
+    */
+
+    BoundedAsyncStack(EventLoop &loop, unsigned int capacity)
+        : _items(checkedCapacity(capacity)), _count(0), _loop(loop) {}
+
+    /**
+      Distruttore: le attese ancora pendenti vengono annullate
+    */
+
+    ~BoundedAsyncStack() {
+        _poppers.cancelAll(_loop);
+        _pushers.cancelAll(_loop);
+    }
+
+    /**
+      Inserisce un elemento, sospendendo la coroutine se lo stack e' pieno
+
+      @param value valore da inserire
+      @param token token per annullare l'attesa
+
+      @return awaitable da attendere con co_await
+
+      @throw AsyncStackCancelled se l'attesa viene annullata
+      @throw std::overflow_error se alla ripresa lo stack e' ancora pieno
+    */
+
+    [[nodiscard]] PushAwaiter push(T value, std::stop_token token = std::stop_token()) {
+        return PushAwaiter(this, std::move(value), std::move(token));
+    }
+
+    /**
+      Inserisce un elemento senza attendere
+
+      @param value valore da inserire
+
+      @return false se lo stack e' pieno e nessuno e' in attesa
+    */
+
+    bool offer(T value) {
+        if(typename AsyncWaitList<T>::Waiter *w = _poppers.dequeue()){
+            w->value.emplace(std::move(value));
+            _loop.post(w->handle);
+            return true;
+        }
+        if(_count == capacity())
+            return false;
+        _items.push(std::move(value));
+        ++_count;
+        return true;
+    }
+
+    /**
+      Rimuove l'elemento in cima, sospendendo la coroutine se lo stack e' vuoto
+
+      @param token token per annullare l'attesa
+
+      @return awaitable che produce il valore rimosso
+
+      @throw AsyncStackCancelled se l'attesa viene annullata
+    */
+
+    PopAwaiter pop(std::stop_token token = std::stop_token()) {
+        return PopAwaiter(this, std::move(token));
+    }
+
+    /**
+      Annulla tutte le push e pop in attesa
+    */
+
+    void cancelAll() {
+        _poppers.cancelAll(_loop);
+        _pushers.cancelAll(_loop);
+    }
+
+    bool stackEmpty() const {
+        return _count == 0;
+    }
+
+    /**
+      @return numero di elementi presenti, come AsyncStack::size()
+    */
+
+    unsigned int size() const {
+        return _count;
+    }
+
+    /**
+      @return numero massimo di elementi
+    */
+
+    unsigned int capacity() const {
+        return _items.size();
+    }
+};
+
+#endif
@@ -0,0 +1,70 @@
+/**
+  @file bench_async.cpp
+
+  @brief Benchmark di latenza degli stack asincroni
+
+  Misura il tempo tra la push di un elemento e la ripresa della
+  coroutine sospesa in pop(), e il throughput di push/pop sullo
+  stack limitato con produttore e consumatore entrambi coroutine.
+*/
+
+#include "async_stack.hpp"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+  @brief Consumatore che registra la latenza di consegna di ogni elemento
+*/
+
+Task latencyConsumer(AsyncStack<Clock::time_point> &st, unsigned int count, std::vector<double> &lat){
+    for(unsigned int i = 0; i < count; ++i){
+        Clock::time_point sent = co_await st.pop();
+        lat.push_back(std::chrono::duration<double, std::nano>(Clock::now() - sent).count());
+    }
+}
+
+Task boundedProducer(BoundedAsyncStack<unsigned int> &st, unsigned int count){
+    for(unsigned int i = 0; i < count; ++i)
+        co_await st.push(i);
+}
+
+Task boundedConsumer(BoundedAsyncStack<unsigned int> &st, unsigned int count, unsigned long long &sum){
+    for(unsigned int i = 0; i < count; ++i)
+        sum += co_await st.pop();
+}
+
+int main(){
+    const unsigned int samples = 1000000;
+    EventLoop loop;
+
+    AsyncStack<Clock::time_point> st(loop);
+    std::vector<double> lat;
+    lat.reserve(samples);
+    latencyConsumer(st, samples, lat).spawn(loop);
+    loop.run();
+    // Il consumatore e' sospeso: ogni push lo riprende al giro successivo del loop
+    for(unsigned int i = 0; i < samples; ++i){
+        st.push(Clock::now());
+        loop.runOne();
+    }
+    std::sort(lat.begin(), lat.end());
+    std::cout << "Latenza push -> ripresa (ns): p50 " << lat[lat.size() / 2]
+              << ", p99 " << lat[lat.size() * 99 / 100]
+              << ", p99.9 " << lat[lat.size() * 999 / 1000]
+              << ", max " << lat.back() << std::endl;
+
+    BoundedAsyncStack<unsigned int> bst(loop, 64);
+    unsigned long long sum = 0;
+    Clock::time_point t0 = Clock::now();
+    boundedProducer(bst, samples).spawn(loop);
+    boundedConsumer(bst, samples, sum).spawn(loop);
+    loop.run();
+    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    std::cout << "Stack limitato (capacita' 64): " << samples / secs / 1e6
+              << " M elementi/s (checksum " << sum << ")" << std::endl;
+    return 0;
+}
@@ -0,0 +1,97 @@
+/**
+  @file bench_multistack.cpp
+
+  @brief Benchmark di MultiStack rispetto a uno Stack per vertice
+
+  Simula le liste di adiacenza di un grafo con uno stack per vertice
+  e confronta tempo di costruzione, memoria heap e tempo di visita
+  tra un vettore di Stack<int> e un MultiStack<int>. Il numero di
+  vertici si puo' passare come primo argomento.
+*/
+
+#include "stack.hpp"
+#include "multi_stack.hpp"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <malloc.h> // mallinfo2
+
+typedef std::chrono::steady_clock Clock;
+
+// Byte attualmente allocati sullo heap
+static std::size_t heapBytes(){
+    struct mallinfo2 mi = mallinfo2();
+    return mi.uordblks + mi.hblkhd;
+}
+
+// Grado pseudo-casuale del vertice v, tra 0 e 10
+static unsigned int degree(unsigned int v){
+    return (v * 2654435761u >> 16) % 11;
+}
+
+int main(int argc, char *argv[]){
+    unsigned int vertices = argc > 1 ? static_cast<unsigned int>(std::strtoul(argv[1], nullptr, 10)) : 2000000;
+    std::cout << "Vertici: " << vertices << std::endl;
+
+    {
+        std::size_t before = heapBytes();
+        Clock::time_point t0 = Clock::now();
+        std::vector<Stack<int> > adj(vertices);
+        for(unsigned int v = 0; v < vertices; ++v){
+            for(unsigned int i = 0; i < degree(v); ++i)
+                adj[v].push(static_cast<int>((v + i) % vertices));
+        }
+        Clock::time_point t1 = Clock::now();
+        long long sum = 0;
+        for(unsigned int v = 0; v < vertices; ++v){
+            Stack<int>::const_iterator b, e;
+            for(b = adj[v].cbegin(), e = adj[v].cend(); b != e; ++b)
+                sum += *b;
+        }
+        Clock::time_point t2 = Clock::now();
+        std::cout << "Stack per vertice: costruzione "
+                  << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms, visita "
+                  << std::chrono::duration<double, std::milli>(t2 - t1).count() << " ms, memoria "
+                  << (heapBytes() - before) / 1048576.0 << " MiB (checksum " << sum << ")" << std::endl;
+    }
+
+    {
+        std::size_t before = heapBytes();
+        Clock::time_point t0 = Clock::now();
+        MultiStack<int> adj(vertices);
+        for(unsigned int v = 0; v < vertices; ++v){
+            for(unsigned int i = 0; i < degree(v); ++i)
+                adj.push(v, static_cast<int>((v + i) % vertices));
+        }
+        Clock::time_point t1 = Clock::now();
+        long long sum = 0;
+        for(unsigned int v = 0; v < vertices; ++v){
+            MultiStack<int>::const_iterator b, e;
+            for(b = adj.cbegin(v), e = adj.cend(v); b != e; ++b)
+                sum += *b;
+        }
+        Clock::time_point t2 = Clock::now();
+        std::cout << "MultiStack:        costruzione "
+                  << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms, visita "
+                  << std::chrono::duration<double, std::milli>(t2 - t1).count() << " ms, memoria "
+                  << (heapBytes() - before) / 1048576.0 << " MiB (checksum " << sum << ")" << std::endl;
+    }
+
+    {
+        // Con il grado noto in anticipo ogni stack va subito nella classe giusta
+        std::size_t before = heapBytes();
+        Clock::time_point t0 = Clock::now();
+        MultiStack<int> adj(vertices);
+        for(unsigned int v = 0; v < vertices; ++v){
+            adj.reserve(v, degree(v));
+            for(unsigned int i = 0; i < degree(v); ++i)
+                adj.push(v, static_cast<int>((v + i) % vertices));
+        }
+        Clock::time_point t1 = Clock::now();
+        std::cout << "MultiStack+reserve: costruzione "
+                  << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms, memoria "
+                  << (heapBytes() - before) / 1048576.0 << " MiB" << std::endl;
+    }
+    return 0;
+}
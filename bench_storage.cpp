@@ -0,0 +1,68 @@
+/**
+  @file bench_storage.cpp
+
+  @brief Benchmark delle politiche di allocazione per stack di grandi dimensioni
+
+  Riempie stack di interi con HeapStorage e con le varianti di
+  MappedStorage e misura il throughput di iterazione e di transform.
+  Il numero di elementi si puo' passare come primo argomento.
+*/
+
+#include "stack_storage.hpp"
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+  @brief Funtore di trasformazione usato dal benchmark
+*/
+
+struct AddOne {
+    int operator()(int x) const {
+        return x + 1;
+    }
+};
+
+template <typename S>
+void run(const char *name, unsigned int n, unsigned int rounds) {
+    Clock::time_point t0 = Clock::now();
+    Stack<int, S> st(n);
+    for(unsigned int i = 0; i < n; ++i)
+        st.push(static_cast<int>(i & 0xff));
+    Clock::time_point t1 = Clock::now();
+
+    long long sum = 0;
+    for(unsigned int r = 0; r < rounds; ++r){
+        typename Stack<int, S>::const_iterator b, e;
+        for(b = st.cbegin(), e = st.cend(); b != e; ++b)
+            sum += *b;
+    }
+    Clock::time_point t2 = Clock::now();
+
+    for(unsigned int r = 0; r < rounds; ++r)
+        transform(st, AddOne());
+    Clock::time_point t3 = Clock::now();
+
+    double gb = static_cast<double>(n) * sizeof(int) * rounds / 1e9;
+    std::cout << name
+              << ": riempimento " << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms"
+              << ", iterazione " << gb / std::chrono::duration<double>(t2 - t1).count() << " GB/s"
+              << ", transform " << gb / std::chrono::duration<double>(t3 - t2).count() << " GB/s"
+              << " (checksum " << sum << ")" << std::endl;
+}
+
+int main(int argc, char *argv[]){
+    unsigned int n = argc > 1 ? static_cast<unsigned int>(std::strtoul(argv[1], nullptr, 10)) : (1u << 26);
+    unsigned int rounds = 5;
+    std::cout << "Elementi: " << n << ", passate: " << rounds << std::endl;
+
+    run<HeapStorage<int> >("new[]                     ", n, rounds);
+    run<MappedStorage<int, HUGEPAGE_NONE> >("mmap 4 KiB                ", n, rounds);
+    run<MappedStorage<int, HUGEPAGE_TRANSPARENT> >("huge page trasparenti     ", n, rounds);
+    run<MappedStorage<int, HUGEPAGE_TRANSPARENT, NUMA_DEFAULT, 0, true> >("huge page + prefault      ", n, rounds);
+    run<MappedStorage<int, HUGEPAGE_EXPLICIT> >("huge page esplicite       ", n, rounds);
+    run<MappedStorage<int, HUGEPAGE_TRANSPARENT, NUMA_INTERLEAVE> >("huge page + interleave    ", n, rounds);
+    return 0;
+}
@@ -0,0 +1,97 @@
+/**
+  @file bench_vm.cpp
+
+  @brief Benchmark della macchina a stack
+
+  Confronta la valutazione ripetuta di un'espressione RPN interpretata
+  token per token su uno Stack con l'esecuzione del bytecode compilato
+  da ExpressionCompiler ed eseguito da StackVM.
+*/
+
+#include "stack_vm.hpp"
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <string>
+
+/**
+  @brief Valutazione ingenua di un'espressione RPN
+
+  Scorre i token a ogni valutazione e usa push/pop controllati di Stack.
+*/
+
+double evalRPNNaive(const std::vector<std::string> &tokens,
+                    const std::vector<std::string> &names,
+                    const double *vars) {
+    Stack<double> st(tokens.size());
+    for(unsigned int i = 0; i < tokens.size(); ++i){
+        const std::string &tok = tokens[i];
+        if(tok == "+" || tok == "-" || tok == "*" || tok == "/" || tok == "<" || tok == ">"){
+            double b = st.pop();
+            double a = st.pop();
+            if(tok == "+")      st.push(a + b);
+            else if(tok == "-") st.push(a - b);
+            else if(tok == "*") st.push(a * b);
+            else if(tok == "/") st.push(a / b);
+            else if(tok == "<") st.push(a < b);
+            else                st.push(a > b);
+        } else if(tok == "neg"){
+            st.push(-st.pop());
+        } else if(std::isdigit(static_cast<unsigned char>(tok[0]))){
+            st.push(std::strtod(tok.c_str(), nullptr));
+        } else {
+            unsigned int v = 0;
+            while(names[v] != tok)
+                ++v;
+            st.push(vars[v]);
+        }
+    }
+    return st.pop();
+}
+
+int main(){
+    const char *expr = "x 2 * y + z 3 / - x y * < 10 x neg - +";
+    const unsigned int iterations = 5000000;
+
+    std::vector<std::string> names;
+    names.push_back("x");
+    names.push_back("y");
+    names.push_back("z");
+
+    std::vector<std::string> tokens;
+    std::istringstream in(expr);
+    std::string tok;
+    while(in >> tok)
+        tokens.push_back(tok);
+
+    ExpressionCompiler<double> compiler(names);
+    Program<double> prog = compiler.compileRPN(expr);
+    StackVM<double> vm;
+    vm.reserve(prog);
+
+    double vars[3] = {1.0, 2.0, 3.0};
+    double sumNaive = 0, sumVM = 0;
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for(unsigned int i = 0; i < iterations; ++i){
+        vars[0] = i & 1023;
+        sumNaive += evalRPNNaive(tokens, names, vars);
+    }
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    for(unsigned int i = 0; i < iterations; ++i){
+        vars[0] = i & 1023;
+        sumVM += vm.run(prog, vars);
+    }
+    std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+
+    double naiveNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / iterations;
+    double vmNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / iterations;
+
+    std::cout << "Espressione: " << expr << std::endl;
+    std::cout << "Istruzioni: " << prog.code.size() << ", profondita' massima: " << prog.maxDepth << std::endl;
+    std::cout << "Stack ingenuo: " << naiveNs << " ns/valutazione (checksum " << sumNaive << ")" << std::endl;
+    std::cout << "StackVM:       " << vmNs << " ns/valutazione (checksum " << sumVM << ")" << std::endl;
+    std::cout << "Speedup: " << naiveNs / vmNs << "x" << std::endl;
+    return 0;
+}
@@ -7,6 +7,11 @@
 */
 
 #include "stack.hpp"
+#include "stack_vm.hpp"
+#include "async_stack.hpp"
+#include "stack_storage.hpp"
+#include "multi_stack.hpp"
+#include <string>
 #include<iostream>
 #include<cassert>
 
@@ -149,12 +154,278 @@ void test_underflow(){
   st.pop();
 }
 
+/**
+  @brief Test della macchina a stack
+
+  Compila espressioni RPN e infisse e ne verifica la valutazione
+*/
+
+void test_stack_vm(){
+  std::cout<<"******** Test della macchina a stack ********"<<std::endl;
+  std::vector<std::string> vars;
+  vars.push_back("x");
+  vars.push_back("y");
+  ExpressionCompiler<int> compiler(vars);
+  StackVM<int> vm;
+  int values[2] = {6, 4};
+
+  Program<int> rpn = compiler.compileRPN("x y + 2 *");
+  vm.reserve(rpn);
+  std::cout << "x y + 2 * = " << vm.run(rpn, values) << std::endl;
+  assert(vm.run(rpn, values) == 20);
+  assert(rpn.maxDepth == 2);
+
+  Program<int> infix = compiler.compileInfix("-(x - 1) * y + 10 / 2 >= y");
+  vm.reserve(infix);
+  std::cout << "-(x - 1) * y + 10 / 2 >= y = " << vm.run(infix, values) << std::endl;
+  assert(vm.run(infix, values) == 0);
+
+  Program<int> prec = compiler.compileInfix("x - y - 1 + 2 * 3");
+  vm.reserve(prec);
+  assert(vm.run(prec, values) == 7);
+
+  bool rejected = false;
+  try{
+    compiler.compileRPN("x +");
+  }catch(const std::invalid_argument &){
+    rejected = true;
+  }
+  assert(rejected);
+
+  // Stack degli operandi non preparato con reserve()
+  StackVM<int> small(1);
+  rejected = false;
+  try{
+    small.run(rpn, values);
+  }catch(const std::length_error &){
+    rejected = true;
+  }
+  assert(rejected);
+  small.reserve(rpn);
+  assert(small.run(rpn, values) == 20);
+
+  // Divisione intera per zero
+  Program<int> div = compiler.compileInfix("x / (y - 4)");
+  vm.reserve(div);
+  rejected = false;
+  try{
+    vm.run(div, values);
+  }catch(const std::domain_error &){
+    rejected = true;
+  }
+  assert(rejected);
+}
+
+/**
+  @brief Coroutine consumatrice per il test degli stack asincroni
+
+  Estrae count elementi e li accoda nel vettore out
+*/
+
+Task consumer(AsyncStack<int> &st, int count, std::vector<int> &out){
+  for(int i = 0; i < count; ++i){
+    out.push_back(co_await st.pop());
+  }
+}
+
+/**
+  @brief Coroutine che attende un elemento e registra l'annullamento
+*/
+
+Task cancellable_consumer(AsyncStack<int> &st, std::stop_token token, bool &cancelled){
+  try{
+    co_await st.pop(token);
+  }catch(const AsyncStackCancelled &){
+    cancelled = true;
+  }
+}
+
+/**
+  @brief Coroutine produttrice per il test dello stack limitato
+*/
+
+Task producer(BoundedAsyncStack<int> &st, int count, int &pushed){
+  for(int i = 0; i < count; ++i){
+    co_await st.push(i);
+    ++pushed;
+  }
+}
+
+/**
+  @brief Test degli stack asincroni
+
+  Verifica sospensione e ripresa delle coroutine, annullamento
+  e push sospese sullo stack limitato
+*/
+
+void test_async_stack(){
+  std::cout<<"******** Test degli stack asincroni ********"<<std::endl;
+  EventLoop loop;
+  AsyncStack<int> st(loop);
+  std::vector<int> out;
+
+  consumer(st, 3, out).spawn(loop);
+  loop.run();
+  assert(out.empty()); // la coroutine e' sospesa sullo stack vuoto
+
+  st.push(1);
+  loop.run();
+  st.push(2);
+  st.push(3);
+  loop.run();
+  assert(out.size() == 3 && out[0] == 1 && out[1] == 2 && out[2] == 3);
+
+  std::stop_source source;
+  bool cancelled = false;
+  cancellable_consumer(st, source.get_token(), cancelled).spawn(loop);
+  loop.run();
+  source.request_stop();
+  loop.run();
+  assert(cancelled);
+  std::cout << "Attesa annullata: " << cancelled << std::endl;
+
+  BoundedAsyncStack<int> bst(loop, 2);
+  int pushed = 0;
+  producer(bst, 4, pushed).spawn(loop);
+  loop.run();
+  assert(pushed == 2); // il produttore e' sospeso sullo stack pieno
+  assert(bst.size() == 2 && bst.capacity() == 2);
+  int v = 0;
+  Task drain = [](BoundedAsyncStack<int> &s, int &last) -> Task {
+    for(int i = 0; i < 4; ++i)
+      last = co_await s.pop();
+  }(bst, v);
+  drain.spawn(loop);
+  loop.run();
+  assert(pushed == 4);
+  assert(bst.stackEmpty() && bst.size() == 0);
+  std::cout << "Push completate: " << pushed << std::endl;
+
+  bool rejected = false;
+  try{
+    BoundedAsyncStack<int> none(loop, 0);
+  }catch(const std::invalid_argument &){
+    rejected = true;
+  }
+  assert(rejected);
+}
+
+/**
+  @brief Test della politica di allocazione MappedStorage
+
+  Verifica le operazioni fondamentali su stack allocati con mmap,
+  anche per tipi con costruttore e distruttore non banali
+*/
+
+void test_mapped_storage(){
+  std::cout<<"******** Test dello stack su huge page ********"<<std::endl;
+  MultiplyByTwo t;
+  Stack<int, MappedStorage<int, HUGEPAGE_TRANSPARENT, NUMA_INTERLEAVE, 0, true> > st(1000);
+  for(int i = 0; i < 1000; ++i)
+    st.push(i);
+  transform(st, t);
+  assert(st.pop() == 1998);
+
+  Stack<int, MappedStorage<int, HUGEPAGE_TRANSPARENT, NUMA_INTERLEAVE, 0, true> > st2(st);
+  assert(st2.pop() == 1996);
+  st2 = st;
+  assert(st2.pop() == 1996);
+
+  Stack<std::string, MappedStorage<std::string, HUGEPAGE_NONE> > names(3);
+  names.push("log.txt");
+  names.push("main.cpp");
+  names.print();
+  assert(names.pop() == "main.cpp");
+}
+
+/**
+  @brief Test della classe MultiStack
+
+  Verifica push/pop su piu' stack logici, la crescita per classi
+  di capacita', gli iteratori e la liberazione in blocco
+*/
+
+void test_multi_stack(){
+  std::cout<<"******** Test di MultiStack ********"<<std::endl;
+  MultiStack<int> ms(3);
+  MultiplyByTwo t;
+
+  for(int i = 0; i < 100; ++i)
+    ms.push(0, i);
+  ms.push(1, 7);
+  assert(ms.stackEmpty(2));
+  assert(ms.count(0) == 100 && ms.size(0) == 160);
+  assert(ms.size(1) == 2 && ms.size(2) == 0);
+
+  // reserve sceglie la classe esatta fino a 8 elementi, poi spreca al piu' un quarto
+  ms.reserve(2, 7);
+  assert(ms.size(2) == 7);
+  ms.reserve(2, 33);
+  assert(ms.size(2) == 40 && ms.stackEmpty(2));
+
+  transform(ms, 1, t);
+  assert(ms.pop(1) == 14);
+  assert(ms.stackEmpty(1));
+
+  int expected = 0;
+  MultiStack<int>::const_iterator b, e;
+  for(b = ms.cbegin(0), e = ms.cend(0); b != e; ++b, ++expected)
+    assert(*b == expected);
+  assert(expected == 100);
+  assert(ms.pop(0) == 99);
+
+  // Lo slot liberato da uno stack viene riutilizzato da un altro
+  ms.svuotaStack(0);
+  for(int i = 0; i < 5; ++i)
+    ms.push(2, i);
+  std::cout << "Memoria occupata: " << ms.memoryUsage() << " byte" << std::endl;
+
+  ms.clear();
+  assert(ms.stacks() == 0);
+}
+
+/**
+  @brief Test delle operazioni veloci dello stack
+
+  Verifica la copia dei soli elementi presenti, il riuso del buffer
+  nell'assegnamento e le operazioni senza controlli
+*/
+
+void test_fast_paths(){
+  std::cout<<"******** Test delle operazioni senza controlli ********"<<std::endl;
+  Stack<int> big(1000000);
+  big.push(1);
+  big.push(2);
+
+  Stack<int> copy(big); // copia solo due elementi
+  assert(copy.size() == 1000000);
+  assert(copy.pop() == 2 && copy.pop() == 1 && copy.stackEmpty());
+
+  copy.push_unchecked(7);
+  copy.push_unchecked(9);
+  assert(copy.pop_unchecked() == 9);
+
+  copy = big; // stessa capacita': il buffer viene riutilizzato
+  assert(copy.pop() == 2);
+
+  Stack<std::string> names(4);
+  names.push_unchecked("a");
+  names.push_unchecked("b");
+  Stack<std::string> names2(names);
+  assert(names2.pop_unchecked() == "b");
+  names2.print();
+}
 
 int main(){
 
     test_metodi_fondamentali_int();
     test_uso_int();
     test_riempi_stack();
+    test_stack_vm();
+    test_async_stack();
+    test_mapped_storage();
+    test_multi_stack();
+    test_fast_paths();
     //test_overflow();
     //test_underflow();
     return 0;
@@ -0,0 +1,533 @@
+/**
+  @file multi_stack.hpp
+
+  @brief File header della classe MultiStack templata
+
+  File di dichiarazioni/definizioni di MultiStack, contenitore che
+  gestisce molti stack logici di oggetti T all'interno di pochi
+  segmenti condivisi, uno per classe di capacita'.
+*/
+
+#ifndef MULTI_STACK_HPP
+#define MULTI_STACK_HPP
+#include <vector>
+#include <iterator>  // std::forward_iterator_tag
+#include <stdexcept> // std::underflow_error, std::out_of_range
+#include <cstddef>   // ptrdiff_t
+
+/**
+  @brief Classe MultiStack
+
+  Ogni stack logico e' identificato da un handle compatto e occupa uno
+  slot nel segmento della sua classe. Le classi valgono 1..8 elementi e
+  poi quattro per ogni raddoppio (10, 12, 14, 16, 20, ...), quindi uno
+  slot spreca al piu' un quarto della sua capacita'. Quando uno slot si
+  riempie lo stack viene spostato in una classe circa 1.5 volte piu'
+  grande e lo slot precedente torna nella lista libera della sua classe;
+  reserve() lo porta invece direttamente nella classe esatta.
+  Uno stack vuoto appena creato non occupa memoria nei segmenti.
+  I segmenti crescono per blocchi di dimensione fissa, quindi non
+  vengono mai riallocati e lo spreco e' al piu' un blocco per classe.
+
+  Il costo fisso per stack resta il descrittore da 8 byte: con stack di
+  pochi elementi i dati stessi dominano la memoria, per cui rispetto a
+  uno Stack<T> per stack il guadagno e' di circa 2 volte in memoria, non
+  di un ordine di grandezza, e il tempo di costruzione cala solo se il
+  numero di elementi e' noto e si usa reserve() (vedi bench_multistack.cpp).
+
+  Gli iteratori iterano dal fondo alla cima come quelli di Stack e
+  vengono invalidati solo da una push sullo stesso stack logico.
+*/
+
+template <typename T>
+class MultiStack {
+
+public:
+
+    typedef unsigned int Handle; ///<identificativo di uno stack logico
+
+private:
+
+    static const unsigned int NO_CLASS = 0;       ///<classe di uno stack senza slot
+    static const unsigned int MIN_CLASS = 1;      ///<prima classe: slot da 1 elemento
+    static const unsigned int MAX_CLASS = 123;    ///<ultima classe: 7 * 2^29 elementi
+    static const unsigned int CLASS_BITS = 7;     ///<bit della classe nel descrittore
+    static const unsigned int MAX_SLOTS = 1u << (32 - CLASS_BITS); ///<slot per classe
+    static const unsigned int CHUNK_LOG = 14;     ///<blocchi da almeno 2^14 elementi
+
+    /**
+      @brief Descrittore di uno stack logico (8 byte)
+    */
+
+    struct Descriptor {
+        unsigned int loc;    ///<classe nei 7 bit bassi, indice dello slot nei restanti
+        unsigned int count;  ///<numero di elementi presenti
+
+        unsigned int cls() const { return loc & ((1u << CLASS_BITS) - 1); }
+        unsigned int slot() const { return loc >> CLASS_BITS; }
+    };
+
+    /**
+      @brief Segmento di una classe di capacita'
+
+      Gli slot sono raggruppati in blocchi di 2^chunkLog slot ciascuno,
+      abbastanza da occupare almeno 2^CHUNK_LOG elementi.
+    */
+
+    struct Segment {
+        std::vector<std::vector<T> > chunks; ///<blocchi di slot contigui di capacityOf(classe) elementi
+        std::vector<unsigned int> freeSlots; ///<slot liberi riutilizzabili
+        unsigned int used;                   ///<slot mai rilasciati in uso o liberi
+        unsigned int chunkLog;               ///<log2 degli slot per blocco
+
+        Segment() : used(0), chunkLog(0) {}
+    };
+
+    std::vector<Descriptor> _stacks;   ///<descrittori indicizzati per handle
+    std::vector<Segment> _segments;    ///<segmenti indicizzati per classe
+
+    // Classi 1..8 esatte, poi (4 + cls % 4) * 2^(cls / 4 - 1): 10, 12, 14, 16, 20, ...
+    static unsigned int capacityOf(unsigned int cls) {
+        if(cls <= 8)
+            return cls;
+        return (4u + (cls & 3)) << ((cls >> 2) - 1);
+    }
+
+    // Classe piu' piccola che contiene n elementi
+    static unsigned int classFor(std::size_t n) {
+        unsigned int cls = MIN_CLASS;
+        while(cls < MAX_CLASS && capacityOf(cls) < n)
+            ++cls;
+        if(capacityOf(cls) < n)
+            throw std::overflow_error("Stack overflow");
+        return cls;
+    }
+
+    // Restituisce uno slot libero della classe, aggiungendo un blocco se serve
+    unsigned int acquireSlot(unsigned int cls) {
+        if(_segments.size() <= cls)
+            _segments.resize(cls + 1);
+        Segment &seg = _segments[cls];
+        if(!seg.freeSlots.empty()){
+            unsigned int slot = seg.freeSlots.back();
+            seg.freeSlots.pop_back();
+            return slot;
+        }
+        if(seg.used == MAX_SLOTS)
+            throw std::length_error("Troppi stack nella stessa classe");
+        if(seg.chunks.empty()){
+            while((static_cast<std::size_t>(capacityOf(cls)) << seg.chunkLog) < (1u << CHUNK_LOG))
+                ++seg.chunkLog;
+        }
+        if((seg.used >> seg.chunkLog) == seg.chunks.size()){
+            seg.chunks.push_back(std::vector<T>());
+            seg.chunks.back().resize(static_cast<std::size_t>(capacityOf(cls)) << seg.chunkLog);
+        }
+        return seg.used++;
+    }
+
+    void releaseSlot(Descriptor &d) {
+        if(d.cls() != NO_CLASS)
+            _segments[d.cls()].freeSlots.push_back(d.slot());
+        d.loc = NO_CLASS;
+    }
+
+    T *slotBase(unsigned int cls, unsigned int slot) {
+        Segment &seg = _segments[cls];
+        unsigned int inChunk = slot & ((1u << seg.chunkLog) - 1);
+        return seg.chunks[slot >> seg.chunkLog].data() + static_cast<std::size_t>(inChunk) * capacityOf(cls);
+    }
+
+    T *base(const Descriptor &d) {
+        return slotBase(d.cls(), d.slot());
+    }
+
+    const T *base(const Descriptor &d) const {
+        const Segment &seg = _segments[d.cls()];
+        unsigned int inChunk = d.slot() & ((1u << seg.chunkLog) - 1);
+        return seg.chunks[d.slot() >> seg.chunkLog].data() + static_cast<std::size_t>(inChunk) * capacityOf(d.cls());
+    }
+
+    // Sposta lo stack in uno slot della classe cls, se e' piu' grande della sua
+    void relocate(Descriptor &d, unsigned int cls) {
+        if(d.cls() != NO_CLASS && d.cls() >= cls)
+            return;
+        unsigned int slot = acquireSlot(cls);
+        if(d.cls() != NO_CLASS){
+            T *src = base(d);
+            T *dst = slotBase(cls, slot);
+            for(unsigned int i = 0; i < d.count; ++i)
+                dst[i] = src[i];
+            releaseSlot(d);
+        }
+        d.loc = (slot << CLASS_BITS) | cls;
+    }
+
+    Descriptor &at(Handle h) {
+        if(h >= _stacks.size())
+            throw std::out_of_range("Handle non valido");
+        return _stacks[h];
+    }
+
+    const Descriptor &at(Handle h) const {
+        if(h >= _stacks.size())
+            throw std::out_of_range("Handle non valido");
+        return _stacks[h];
+    }
+
+public:
+
+    /**
+      Costruttore di default
+
+      @post nessuno stack logico
+    */
+
+    MultiStack() {}
+
+    /**
+      Costruttore parametrico: crea n stack vuoti con handle da 0 a n-1
+      @param n numero di stack da creare
+
+      @throw std::bad_alloc possibile eccezione di allocazione
+    */
+
+    explicit MultiStack(unsigned int n) {
+        create(n);
+    }
+
+    /**
+      Crea uno stack logico vuoto
+
+      @return handle del nuovo stack
+
+      @throw std::bad_alloc possibile eccezione di allocazione
+    */
+
+    Handle create() {
+        Descriptor d = {NO_CLASS, 0};
+        _stacks.push_back(d);
+        return static_cast<Handle>(_stacks.size() - 1);
+    }
+
+    /**
+      Crea n stack logici vuoti con handle consecutivi
+
+      @param n numero di stack da creare
+
+      @return handle del primo stack creato
+
+      @throw std::bad_alloc possibile eccezione di allocazione
+    */
+
+    Handle create(unsigned int n) {
+        Handle first = static_cast<Handle>(_stacks.size());
+        Descriptor d = {NO_CLASS, 0};
+        _stacks.resize(_stacks.size() + n, d);
+        return first;
+    }
+
+    /**
+      Funzione che ritorna il numero di stack logici
+
+      @return numero di handle validi
+    */
+
+    unsigned int stacks() const {
+        return static_cast<unsigned int>(_stacks.size());
+    }
+
+    /**
+      Aggiunge un elemento nella cima dello stack h
+
+      @param h handle dello stack
+      @param value valore da inserire
+
+      @throw std::overflow_error possibile eccezione di stack overflow
+      @throw std::out_of_range handle non valido
+      @throw std::bad_alloc possibile eccezione di allocazione
+    */
+
+    void push(Handle h, T value) {
+        Descriptor &d = at(h);
+        if(d.cls() == NO_CLASS || d.count == capacityOf(d.cls())){
+            std::size_t n = d.count + static_cast<std::size_t>(d.count) / 2 + 2;
+            if(n > capacityOf(MAX_CLASS))
+                n = static_cast<std::size_t>(d.count) + 1;
+            relocate(d, classFor(n));
+        }
+        base(d)[d.count] = value;
+        ++d.count;
+    }
+
+    /**
+      Riserva spazio per almeno n elementi nello stack h, spostandolo
+      direttamente nella classe adatta invece di crescere per passi
+
+      @param h handle dello stack
+      @param n numero di elementi da poter contenere
+
+      @throw std::overflow_error n supera la classe massima
+      @throw std::out_of_range handle non valido
+      @throw std::bad_alloc possibile eccezione di allocazione
+    */
+
+    void reserve(Handle h, unsigned int n) {
+        Descriptor &d = at(h);
+        relocate(d, classFor(n));
+    }
+
+    /**
+      Rimuove un elemento dalla cima dello stack h e lo restituisce
+
+      @param h handle dello stack
+
+      @return valore rimosso dalla cima dello stack
+
+      @throw std::underflow_error possibile eccezione di stack underflow
+      @throw std::out_of_range handle non valido
+    */
+
+    T pop(Handle h) {
+        Descriptor &d = at(h);
+        if(d.count == 0)
+            throw std::underflow_error("Stack underflow");
+        --d.count;
+        return base(d)[d.count];
+    }
+
+    /**
+      Funzione che controlla se lo stack h sia vuoto
+
+      @param h handle dello stack
+
+      @return true se lo stack e' vuoto
+    */
+
+    bool stackEmpty(Handle h) const {
+        return at(h).count == 0;
+    }
+
+    /**
+      Funzione che ritorna il numero di elementi dello stack h
+
+      @param h handle dello stack
+
+      @return elementi presenti
+    */
+
+    unsigned int count(Handle h) const {
+        return at(h).count;
+    }
+
+    /**
+      Funzione che ritorna lo spazio allocato per lo stack h
+
+      @param h handle dello stack
+
+      @return capacita' dello slot, 0 se lo stack non ha slot
+    */
+
+    unsigned int size(Handle h) const {
+        const Descriptor &d = at(h);
+        return d.cls() == NO_CLASS ? 0 : capacityOf(d.cls());
+    }
+
+    /**
+      Svuota lo stack h e restituisce il suo slot al segmento
+
+      @param h handle dello stack
+
+      @post stackEmpty(h)
+    */
+
+    void svuotaStack(Handle h) {
+        Descriptor &d = at(h);
+        releaseSlot(d);
+        d.count = 0;
+    }
+
+    /**
+      Libera in blocco tutti gli stack e i segmenti
+
+      @post stacks() == 0
+    */
+
+    void clear() {
+        std::vector<Descriptor>().swap(_stacks);
+        std::vector<Segment>().swap(_segments);
+    }
+
+    /**
+      Funzione che ritorna la memoria occupata dal contenitore
+
+      @return byte allocati per descrittori, segmenti e liste libere
+    */
+
+    std::size_t memoryUsage() const {
+        std::size_t bytes = _stacks.capacity() * sizeof(Descriptor) + _segments.capacity() * sizeof(Segment);
+        for(std::size_t i = 0; i < _segments.size(); ++i){
+            const Segment &seg = _segments[i];
+            bytes += seg.chunks.capacity() * sizeof(std::vector<T>);
+            for(std::size_t c = 0; c < seg.chunks.size(); ++c)
+                bytes += seg.chunks[c].capacity() * sizeof(T);
+            bytes += seg.freeSlots.capacity() * sizeof(unsigned int);
+        }
+        return bytes;
+    }
+
+    /**
+      Iteratore sugli elementi di uno stack logico, dal fondo alla cima
+    */
+
+    class iterator {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef T                         value_type;
+            typedef ptrdiff_t                 difference_type;
+            typedef T*                        pointer;
+            typedef T&                        reference;
+
+            // Costruttore default
+            iterator() : _ptr(nullptr) {}
+
+            // Ritorna il dato riferito dall'iteratore (dereferenziamento)
+            reference operator*() const {
+                return *_ptr;
+            }
+
+            // Ritorna il puntatore al dato riferito dall'iteratore
+            pointer operator->() const {
+                return _ptr;
+            }
+
+            // Operatore di iterazione pre-incremento
+            iterator& operator++() {
+                ++_ptr;
+                return *this;
+            }
+
+            // Operatore di iterazione post-incremento
+            iterator operator++(int) {
+                iterator temp(*this);
+                ++_ptr;
+                return temp;
+            }
+
+            // Uguaglianza
+            bool operator==(const iterator& other) const {
+                return _ptr == other._ptr;
+            }
+
+            // Diversità
+            bool operator!=(const iterator& other) const {
+                return _ptr != other._ptr;
+            }
+
+        private:
+            T* _ptr; // Puntatore all'elemento corrente
+
+            friend class MultiStack;
+
+            // Costruttore parametrico utilizzato dalla classe container
+            explicit iterator(T* ptr) : _ptr(ptr) {}
+    };
+
+    class const_iterator {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef T                         value_type;
+            typedef ptrdiff_t                 difference_type;
+            typedef const T*                  pointer;
+            typedef const T&                  reference;
+
+            // Costruttore default
+            const_iterator() : _ptr(nullptr) {}
+
+            // Ritorna il dato riferito dall'iteratore (dereferenziamento)
+            reference operator*() const {
+                return *_ptr;
+            }
+
+            // Ritorna il puntatore al dato riferito dall'iteratore
+            pointer operator->() const {
+                return _ptr;
+            }
+
+            // Operatore di iterazione pre-incremento
+            const_iterator& operator++() {
+                ++_ptr;
+                return *this;
+            }
+
+            // Operatore di iterazione post-incremento
+            const_iterator operator++(int) {
+                const_iterator temp(*this);
+                ++_ptr;
+                return temp;
+            }
+
+            // Uguaglianza
+            bool operator==(const const_iterator& other) const {
+                return _ptr == other._ptr;
+            }
+
+            // Diversità
+            bool operator!=(const const_iterator& other) const {
+                return _ptr != other._ptr;
+            }
+
+        private:
+            const T* _ptr; // Puntatore all'elemento corrente
+
+            friend class MultiStack;
+
+            // Costruttore parametrico utilizzato dalla classe container
+            explicit const_iterator(const T* ptr) : _ptr(ptr) {}
+    };
+
+    // Ritorna l'iteratore all'inizio dello stack h
+    iterator begin(Handle h) {
+        Descriptor &d = at(h);
+        return iterator(d.cls() == NO_CLASS ? nullptr : base(d));
+    }
+
+    // Ritorna l'iteratore alla fine dello stack h
+    iterator end(Handle h) {
+        Descriptor &d = at(h);
+        return iterator(d.cls() == NO_CLASS ? nullptr : base(d) + d.count);
+    }
+
+    // Ritorna l'iteratore all'inizio dello stack h
+    const_iterator cbegin(Handle h) const {
+        const Descriptor &d = at(h);
+        return const_iterator(d.cls() == NO_CLASS ? nullptr : base(d));
+    }
+
+    // Ritorna l'iteratore alla fine dello stack h
+    const_iterator cend(Handle h) const {
+        const Descriptor &d = at(h);
+        return const_iterator(d.cls() == NO_CLASS ? nullptr : base(d) + d.count);
+    }
+};
+
+/**
+ @brief funzione globale templata transform
+
+ Trasforma lo stack logico h sovrascrivendo i dati già
+ presenti in base al funtore passato in input
+
+ @param ms contenitore degli stack
+ @param h handle dello stack da trasformare
+ @param f funtore generico da applicare agli elementi dello stack
+ */
+
+template <typename T, typename Funt>
+void transform(MultiStack<T> &ms, typename MultiStack<T>::Handle h, Funt f){
+    typename MultiStack<T>::iterator b, e;
+    for(b = ms.begin(h), e = ms.end(h); b != e; ++b){
+        *b = f(*b);
+    }
+}
+
+#endif
@@ -11,15 +11,38 @@
 #include<algorithm> //std::swap
 #include <iterator> // std::forward_iterator_tag
 #include<iostream>
+#include <cstring> // std::memcpy
+#include <stdexcept> // std::overflow_error, std::underflow_error
+#include <type_traits> // std::is_trivially_copyable
+
+/**
+  @brief Politica di allocazione di default
+
+  Alloca il buffer dello stack con new[]. Una politica di allocazione
+  deve fornire le funzioni statiche allocate(n), che restituisce un
+  buffer di n oggetti T costruiti, e deallocate(p), che lo libera.
+*/
+
+template <typename T>
+struct HeapStorage {
+    static T *allocate(unsigned int n) {
+        return new T[n];
+    }
+
+    static void deallocate(T *p) {
+        delete [] p;
+    }
+};
 
 /**
   @brief Classe stack
 
-  La classe imlementa un genrico stack di oggetti T.
+  La classe imlementa un genrico stack di oggetti T. Il buffer
+  viene allocato tramite la politica Storage (vedi HeapStorage).
 */
 
 
-template <typename T>
+template <typename T, typename Storage = HeapStorage<T> >
 
 class Stack{
 
@@ -29,6 +52,22 @@ private:
     unsigned int _size; ///<dato che rappresenta lo spazio allocato per lo stack
     int _top;  ///<puntatore alla cima della lista
 
+    /**
+    Copia n elementi da src a dst. Per i tipi trivially copyable
+    la copia avviene con una sola memcpy.
+    */
+
+    static void copyElements(T *dst, const T *src, unsigned int n){
+        if constexpr(std::is_trivially_copyable<T>::value){
+            if(n > 0)
+                std::memcpy(static_cast<void *>(dst), static_cast<const void *>(src), n * sizeof(T));
+        } else {
+            for(unsigned int i = 0; i < n; ++i){
+                dst[i] = src[i];
+            }
+        }
+    }
+
 public:
 
     /**
@@ -41,12 +80,8 @@ public:
     */   
 
     Stack(unsigned int size = 10) : _stack(nullptr), _size(size), _top(-1) {
-        try{
-            _stack = new T[_size];
-        }catch(...){
-            clear();
-            throw; 
-        }
+        // Se l'allocazione fallisce non c'e' nulla da liberare
+        _stack = Storage::allocate(_size);
     } 
 
     /**
@@ -62,7 +97,7 @@ public:
     */
 
     template <typename IterT>
-    Stack(IterT b, IterT e): _stack(nullptr), _top(-1), _size(0){
+    Stack(IterT b, IterT e): _stack(nullptr), _size(0), _top(-1){
         unsigned int size = 0;
         IterT app = b;
         //Utiliziamo il ciclo per comprendere quanti valori
@@ -77,10 +112,12 @@ public:
         //La new può fallire, quindi effettuiamo una gestione
         //dell'eccezione con try e catch
         try{
-            _stack = new T[size];
+            _stack = Storage::allocate(size);
             _size = size;
+            // Lo spazio e' stato dimensionato sulla sequenza:
+            // non servono i controlli di overflow di push()
             while(b != e){
-                push(static_cast<T>(*b));
+                push_unchecked(static_cast<T>(*b));
                 ++b;
             }   
         }catch(...){
@@ -100,16 +137,15 @@ public:
     @throw std::bad_alloc possibile eccezione di allocazione
     */
 
-    Stack(const Stack &other): _size(other._size), _top(other._top) {
+    Stack(const Stack &other): _stack(nullptr), _size(other._size), _top(other._top) {
         //Allochiamo memoria per lo stack che stiamo creando
-        //Cicliamo sui valori dei due array
+        //e copiamo solo gli elementi presenti (_top + 1), non
+        //tutta la capacita'
         //La new può fallire, quindi effettuiamo una gestione
         //dell'eccezione con try e catch
         try{
-            _stack = new T[other._size];
-            for(unsigned int i = 0; i < _size; ++i){
-                _stack[i] = other._stack[i];
-            }
+            _stack = Storage::allocate(other._size);
+            copyElements(_stack, other._stack, static_cast<unsigned int>(_top + 1));
         }catch(...){
             // Se c'e' un problema, svuotiamo la lista e rilanciamo
             // l'eccezione
@@ -130,8 +166,14 @@ public:
 
     Stack &operator=(const Stack &other){
         if (this != &other) {
-            Stack temp(other);
-            this->swap(temp);
+            if(_size == other._size && std::is_nothrow_copy_assignable<T>::value){
+                // Stessa capacita': riusiamo il buffer esistente
+                copyElements(_stack, other._stack, static_cast<unsigned int>(other._top + 1));
+                _top = other._top;
+            } else {
+                Stack temp(other);
+                this->swap(temp);
+            }
         }   
         return *this;
     }
@@ -156,10 +198,10 @@ public:
     @post _top = -1
     */
 
-    void clear(){
+    void clear() noexcept{
         _size = 0;
         _top = -1;
-        delete [] _stack;
+        Storage::deallocate(_stack);
         _stack = nullptr;
     }
 
@@ -169,7 +211,7 @@ public:
     @return grandezza dello stack
      */
 
-    unsigned int size() const{
+    unsigned int size() const noexcept{
         return _size;
     }
 
@@ -180,7 +222,7 @@ public:
     @param other stack con cui scambiare o stato
     */
 
-    void swap(Stack& other) {
+    void swap(Stack& other) noexcept{
         std::swap(_stack, other._stack);
         std::swap(_size, other._size);
         std::swap(_top, other._top);
@@ -192,7 +234,7 @@ public:
     @return booleano che definisce se lo stack è pieno
      */
 
-    bool stackEmpty() const{
+    bool stackEmpty() const noexcept{
         return _top == -1;
     }
 
@@ -207,7 +249,7 @@ public:
     */
 
     void push(T value){
-        if(_top + 1 == _size)
+        if(static_cast<unsigned int>(_top + 1) == _size)
             throw std::overflow_error("Stack overflow");
         ++_top;
         _stack[_top] = value;
@@ -231,14 +273,45 @@ public:
         return _stack[tmp];
     }
 
+    /**
+    Aggiunge un elemento nella cima dello stack senza controllare
+    lo spazio disponibile. Da usare solo quando il chiamante ha gia'
+    verificato la capacita'.
+
+    @param value valore da inserire nella lista
+
+    @pre _top + 1 < _size
+
+    @post _top = _top+1
+    */
+
+    void push_unchecked(T value) noexcept(std::is_nothrow_copy_assignable<T>::value){
+        _stack[++_top] = value;
+    }
+
+    /**
+    Rimuove un elemento dalla cima dello stack senza controllare
+    che lo stack non sia vuoto
+
+    @return valore rimosso dalla cima dello stack
+
+    @pre !stackEmpty()
+
+    @post _top = _top-1
+    */
+
+    T pop_unchecked() noexcept(std::is_nothrow_copy_constructible<T>::value){
+        return _stack[_top--];
+    }
+
    /**
     Funzione che effettua la stampa di uno stack dalla cima verso il fondo
     */
 
    void print(){
-        Stack tmp(*this);
-        while(!tmp.stackEmpty()){
-            std::cout<<tmp.pop()<< " ";
+        // Scorriamo il buffer dalla cima senza copiare lo stack
+        for(int i = _top; i >= 0; --i){
+            std::cout<<_stack[i]<< " ";
         }
         std::cout<< std::endl;
    }
@@ -249,11 +322,9 @@ public:
     @post _top = -1
     */
 
-    void svuotaStack(){
-        T r;
-        while(!stackEmpty()){
-            r = pop();
-        }
+    void svuotaStack() noexcept{
+        // Gli elementi restano nel buffer come dopo una serie di pop():
+        // basta riportare la cima in fondo
         _top = -1;
     }
 
@@ -289,7 +360,7 @@ public:
         try{
             _size = size;
             while(b != e){
-                push(static_cast<T>(*b));
+                push_unchecked(static_cast<T>(*b));
                 ++b;
             }   
         }catch(...){
@@ -485,22 +556,22 @@ public:
     };
 
     // Ritorna l'iteratore all'inizio della sequenza dati
-    iterator begin() {
+    iterator begin() noexcept {
         return iterator(_stack);  
     }
 
     // Ritorna l'iteratore alla fine della sequenza dati
-    iterator end() {
+    iterator end() noexcept {
         return iterator(_stack + _top + 1); 
     }
 
     // Ritorna l'iteratore all'inizio della sequenza dati
-    const_iterator cbegin() const {
+    const_iterator cbegin() const noexcept {
         return const_iterator(_stack); 
     }
 
     // Ritorna l'iteratore alla fine della sequenza dati
-    const_iterator cend() const {
+    const_iterator cend() const noexcept {
         return const_iterator(_stack + _top + 1);  
     }
 
@@ -518,9 +589,9 @@ public:
  @param f funtore generico da applicare agli elementi dello stack 
  */
 
-template <typename T, typename Funt>
-void transform(Stack<T> &_stack, Funt f){
-    typename Stack<T>::iterator b, e;
+template <typename T, typename S, typename Funt>
+void transform(Stack<T, S> &_stack, Funt f){
+    typename Stack<T, S>::iterator b, e;
     for(b = _stack.begin(), e = _stack.end(); b != e; ++b){
         *b = f(*b);
     }
@@ -0,0 +1,237 @@
+/**
+  @file stack_storage.hpp
+
+  @brief File header delle politiche di allocazione per stack di grandi dimensioni
+
+  File di dichiarazioni/definizioni di MappedStorage, politica di
+  allocazione per Stack che mappa il buffer con mmap, lo appoggia su
+  huge page (trasparenti o esplicite), ne imposta la politica NUMA e,
+  opzionalmente, lo prefaulta. Su sistemi diversi da Linux ricade su
+  una normale allocazione allineata.
+*/
+
+#ifndef STACK_STORAGE_HPP
+#define STACK_STORAGE_HPP
+#include "stack.hpp"
+#include <new>          // std::bad_alloc, placement new
+#include <type_traits>  // std::is_trivially_default_constructible
+#include <cstddef>      // std::size_t
+#include <cstdint>      // std::uintptr_t
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#else
+#include <cstdlib>
+#endif
+
+/**
+  @brief Uso delle huge page per il buffer
+*/
+
+enum HugePageMode {
+    HUGEPAGE_NONE,        ///<pagine da 4 KiB
+    HUGEPAGE_TRANSPARENT, ///<madvise(MADV_HUGEPAGE), huge page trasparenti
+    HUGEPAGE_EXPLICIT     ///<MAP_HUGETLB, con ripiego sulle huge page trasparenti
+};
+
+/**
+  @brief Politica NUMA del buffer
+*/
+
+enum NumaMode {
+    NUMA_DEFAULT,   ///<politica del processo (first touch)
+    NUMA_BIND,      ///<tutte le pagine sul nodo indicato
+    NUMA_INTERLEAVE ///<pagine distribuite a turno su tutti i nodi
+};
+
+/**
+  @brief Politica di allocazione con mmap, huge page e NUMA
+
+  Il buffer e' preceduto da un'intestazione di 64 byte che memorizza
+  la lunghezza della mappatura e il numero di elementi, cosi' che
+  deallocate() non dipenda dalla capacita' corrente dello stack.
+  Con le huge page trasparenti gli elementi partono da un indirizzo
+  allineato a 2 MiB e l'intestazione occupa la pagina base precedente,
+  cosi' che ogni porzione da 2 MiB dei dati possa essere promossa.
+  La politica NUMA e' un suggerimento: se mbind fallisce (kernel
+  senza NUMA, nodo inesistente) il buffer resta comunque utilizzabile.
+
+  @param Huge uso delle huge page
+  @param Numa politica NUMA
+  @param Node nodo per NUMA_BIND
+  @param Prefault se true tutte le pagine vengono toccate all'allocazione
+*/
+
+template <typename T, HugePageMode Huge = HUGEPAGE_TRANSPARENT,
+          NumaMode Numa = NUMA_DEFAULT, int Node = 0, bool Prefault = false>
+struct MappedStorage {
+
+    /**
+      @brief Intestazione della mappatura
+    */
+
+    struct Header {
+        std::size_t bytes; ///<lunghezza totale della mappatura
+        unsigned int count; ///<numero di elementi costruiti
+    };
+
+    static const std::size_t HEADER_SIZE = 64;      ///<spazio riservato all'intestazione
+    static const std::size_t HUGE_PAGE = 2u << 20;  ///<dimensione delle huge page (2 MiB)
+    static const std::size_t PAGE = 4096;           ///<dimensione delle pagine base
+
+    static_assert(alignof(T) <= HEADER_SIZE, "Allineamento di T non supportato");
+
+    /**
+      Alloca e costruisce un buffer di n elementi
+
+      @param n numero di elementi
+
+      @return puntatore al primo elemento
+
+      @throw std::bad_alloc possibile eccezione di allocazione
+    */
+
+    static T *allocate(unsigned int n) {
+        std::size_t bytes = HEADER_SIZE + static_cast<std::size_t>(n) * sizeof(T);
+        char *base = static_cast<char *>(map(bytes));
+        Header *h = reinterpret_cast<Header *>(base);
+        T *data = reinterpret_cast<T *>(base + HEADER_SIZE);
+        h->count = 0;
+        if(!std::is_trivially_default_constructible<T>::value){
+            try{
+                for(; h->count < n; ++h->count)
+                    new (data + h->count) T();
+            }catch(...){
+                deallocate(data);
+                throw;
+            }
+        } else {
+            h->count = n;
+        }
+        return data;
+    }
+
+    /**
+      Distrugge gli elementi e libera il buffer
+
+      @param p puntatore restituito da allocate(), puo' essere nullptr
+    */
+
+    static void deallocate(T *p) {
+        if(p == nullptr)
+            return;
+        char *base = reinterpret_cast<char *>(p) - HEADER_SIZE;
+        Header *h = reinterpret_cast<Header *>(base);
+        if(!std::is_trivially_destructible<T>::value){
+            for(unsigned int i = 0; i < h->count; ++i)
+                p[i].~T();
+        }
+        unmap(base, h->bytes);
+    }
+
+private:
+
+#if defined(__linux__)
+
+    static std::size_t roundUp(std::size_t bytes, std::size_t page) {
+        return (bytes + page - 1) / page * page;
+    }
+
+    static void *map(std::size_t bytes) {
+        void *addr = MAP_FAILED;
+        std::size_t len = 0;
+        char *base = nullptr;
+
+        if(Huge == HUGEPAGE_EXPLICIT){
+            len = roundUp(bytes, HUGE_PAGE);
+            addr = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            base = static_cast<char *>(addr);
+        }
+        if(addr == MAP_FAILED && Huge == HUGEPAGE_NONE){
+            len = roundUp(bytes, PAGE);
+            addr = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(addr == MAP_FAILED)
+                throw std::bad_alloc();
+            base = static_cast<char *>(addr);
+        } else if(addr == MAP_FAILED){
+            // mmap allinea solo a 4 KiB: si mappano 2 MiB in piu' e si
+            // tiene la finestra in cui i dati partono da un confine di
+            // 2 MiB, preceduti dalla pagina con l'intestazione
+            std::size_t dataLen = roundUp(bytes - HEADER_SIZE, HUGE_PAGE);
+            std::size_t span = PAGE + dataLen + HUGE_PAGE;
+            void *raw = mmap(nullptr, span, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(raw == MAP_FAILED)
+                throw std::bad_alloc();
+            char *first = static_cast<char *>(raw);
+            std::uintptr_t aligned = roundUp(reinterpret_cast<std::uintptr_t>(first) + PAGE, HUGE_PAGE);
+            char *data = first + (aligned - reinterpret_cast<std::uintptr_t>(first));
+            char *start = data - PAGE;
+            char *end = data + dataLen;
+            if(start != first)
+                munmap(first, start - first);
+            if(end != first + span)
+                munmap(end, first + span - end);
+            addr = start;
+            len = end - start;
+            base = data - HEADER_SIZE;
+#if defined(MADV_HUGEPAGE)
+            if(dataLen > 0)
+                madvise(data, dataLen, MADV_HUGEPAGE);
+#endif
+        }
+
+        // La politica NUMA va impostata prima che le pagine vengano toccate
+        if(Numa != NUMA_DEFAULT){
+            unsigned long mask[16] = {0};
+            unsigned long maxnode = sizeof(mask) * 8;
+            int mode;
+            if(Numa == NUMA_BIND){
+                mode = MPOL_BIND;
+                mask[Node / (8 * sizeof(unsigned long))] = 1ul << (Node % (8 * sizeof(unsigned long)));
+            } else {
+                // Il kernel interseca la maschera con i nodi effettivamente disponibili
+                mode = MPOL_INTERLEAVE;
+                for(unsigned int i = 0; i < sizeof(mask) / sizeof(mask[0]); ++i)
+                    mask[i] = ~0ul;
+            }
+            syscall(SYS_mbind, addr, len, mode, mask, maxnode, 0);
+        }
+
+        if(Prefault){
+            for(std::size_t off = 0; off < len; off += PAGE)
+                static_cast<char *>(addr)[off] = 0;
+        }
+        reinterpret_cast<Header *>(base)->bytes = len;
+        return base;
+    }
+
+    // La mappatura parte dall'inizio della pagina che contiene l'intestazione
+    static void unmap(char *base, std::size_t bytes) {
+        munmap(base - reinterpret_cast<std::uintptr_t>(base) % PAGE, bytes);
+    }
+
+#else
+
+    // L'intestazione e' lunga un multiplo di alignof(T): basta allineare l'inizio
+    static const std::size_t ALIGN = alignof(T) > alignof(Header) ? alignof(T) : alignof(Header);
+
+    static void *map(std::size_t bytes) {
+        void *addr = ::operator new(bytes, std::align_val_t(ALIGN));
+        reinterpret_cast<Header *>(addr)->bytes = bytes;
+        return addr;
+    }
+
+    static void unmap(char *base, std::size_t) {
+        ::operator delete(base, std::align_val_t(ALIGN));
+    }
+
+#endif
+};
+
+#endif
@@ -0,0 +1,454 @@
+/**
+  @file stack_vm.hpp
+
+  @brief File header della macchina virtuale a stack per la valutazione di espressioni
+
+  File di dichiarazioni/definizioni del compilatore di espressioni (RPN e
+  infisse) in bytecode e dell'interprete che le valuta. Il compilatore
+  utilizza la classe Stack per l'analisi delle espressioni e calcola in
+  fase di compilazione la profondita' massima dello stack degli operandi,
+  in modo che l'interprete possa lavorare senza controlli a runtime.
+*/
+
+#ifndef STACK_VM_HPP
+#define STACK_VM_HPP
+#include "stack.hpp"
+#include <vector>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <limits>      // std::numeric_limits
+#include <type_traits> // std::is_integral, std::is_signed
+#include <cstdlib> // std::strtod
+#include <cctype>  // std::isdigit, std::isalpha, std::isspace
+
+/**
+  @brief Codici operativi della macchina a stack
+*/
+
+enum OpCode {
+    OP_CONST = 0, ///<carica la costante di indice arg
+    OP_LOAD,      ///<carica la variabile di indice arg
+    OP_ADD,       ///<somma i due valori in cima
+    OP_SUB,       ///<sottrae i due valori in cima
+    OP_MUL,       ///<moltiplica i due valori in cima
+    OP_DIV,       ///<divide i due valori in cima
+    OP_NEG,       ///<cambia segno al valore in cima
+    OP_LT,        ///<confronto minore
+    OP_GT,        ///<confronto maggiore
+    OP_LE,        ///<confronto minore o uguale
+    OP_GE,        ///<confronto maggiore o uguale
+    OP_EQ,        ///<confronto uguale
+    OP_NE,        ///<confronto diverso
+    OP_HALT,      ///<termina e restituisce il valore in cima
+    OP_COUNT      ///<numero di codici operativi
+};
+
+/**
+  @brief Singola istruzione della macchina a stack
+
+  Istruzione compatta di 8 byte: codice operativo e argomento
+  (indice di costante o di variabile, ignorato dagli operatori).
+*/
+
+struct Instruction {
+    unsigned int op;  ///<codice operativo
+    unsigned int arg; ///<argomento dell'istruzione
+};
+
+/**
+  @brief Programma compilato
+
+  Contiene la sequenza di istruzioni, la tabella delle costanti e la
+  profondita' massima dello stack degli operandi verificata dal compilatore.
+*/
+
+template <typename T>
+struct Program {
+    std::vector<Instruction> code;  ///<istruzioni, terminate da OP_HALT
+    std::vector<T> constants;       ///<tabella delle costanti
+    unsigned int maxDepth;          ///<profondita' massima dello stack degli operandi
+
+    Program() : maxDepth(0) {}
+};
+
+/**
+  @brief Compilatore di espressioni in bytecode
+
+  Traduce espressioni in notazione polacca inversa (token separati da
+  spazi) o in notazione infissa in un Program. Le variabili vengono
+  risolte sugli indici del vettore di nomi passato al costruttore.
+*/
+
+template <typename T>
+class ExpressionCompiler {
+
+private:
+
+    std::vector<std::string> _vars; ///<nomi delle variabili ammesse
+
+    // Ritorna il codice dell'operatore binario o OP_COUNT se il token non e' un operatore
+    static unsigned int binaryOp(const std::string &tok) {
+        if(tok == "+")  return OP_ADD;
+        if(tok == "-")  return OP_SUB;
+        if(tok == "*")  return OP_MUL;
+        if(tok == "/")  return OP_DIV;
+        if(tok == "<")  return OP_LT;
+        if(tok == ">")  return OP_GT;
+        if(tok == "<=") return OP_LE;
+        if(tok == ">=") return OP_GE;
+        if(tok == "==") return OP_EQ;
+        if(tok == "!=") return OP_NE;
+        return OP_COUNT;
+    }
+
+    // Precedenza degli operatori nella notazione infissa
+    static int precedence(const std::string &tok) {
+        if(tok == "neg") return 4;
+        if(tok == "*" || tok == "/") return 3;
+        if(tok == "+" || tok == "-") return 2;
+        return 1; // confronti
+    }
+
+    static bool isNumber(const std::string &tok) {
+        return !tok.empty() && (std::isdigit(static_cast<unsigned char>(tok[0])) || tok[0] == '.');
+    }
+
+    static bool isIdentifier(const std::string &tok) {
+        return !tok.empty() && (std::isalpha(static_cast<unsigned char>(tok[0])) || tok[0] == '_');
+    }
+
+    unsigned int variableIndex(const std::string &name) const {
+        for(unsigned int i = 0; i < _vars.size(); ++i){
+            if(_vars[i] == name)
+                return i;
+        }
+        throw std::invalid_argument("Variabile sconosciuta: " + name);
+    }
+
+    // Divide un'espressione infissa in token
+    static std::vector<std::string> tokenizeInfix(const std::string &expr) {
+        std::vector<std::string> tokens;
+        std::string::size_type i = 0;
+        while(i < expr.size()){
+            char c = expr[i];
+            if(std::isspace(static_cast<unsigned char>(c))){
+                ++i;
+            } else if(std::isdigit(static_cast<unsigned char>(c)) || c == '.'){
+                std::string::size_type j = i;
+                while(j < expr.size() && (std::isdigit(static_cast<unsigned char>(expr[j])) || expr[j] == '.'))
+                    ++j;
+                tokens.push_back(expr.substr(i, j - i));
+                i = j;
+            } else if(std::isalpha(static_cast<unsigned char>(c)) || c == '_'){
+                std::string::size_type j = i;
+                while(j < expr.size() && (std::isalnum(static_cast<unsigned char>(expr[j])) || expr[j] == '_'))
+                    ++j;
+                tokens.push_back(expr.substr(i, j - i));
+                i = j;
+            } else if((c == '<' || c == '>' || c == '=' || c == '!') && i + 1 < expr.size() && expr[i + 1] == '='){
+                tokens.push_back(expr.substr(i, 2));
+                i += 2;
+            } else {
+                tokens.push_back(std::string(1, c));
+                ++i;
+            }
+        }
+        return tokens;
+    }
+
+    // Converte i token infissi in RPN con l'algoritmo shunting-yard
+    static std::vector<std::string> toRPN(const std::vector<std::string> &tokens) {
+        std::vector<std::string> output;
+        // Gli indici dei token operatore vengono tenuti su uno Stack
+        Stack<unsigned int> ops(tokens.size() + 1);
+        bool expectOperand = true;
+
+        for(unsigned int i = 0; i < tokens.size(); ++i){
+            const std::string &tok = tokens[i];
+            if(isNumber(tok) || isIdentifier(tok)){
+                output.push_back(tok);
+                expectOperand = false;
+            } else if(tok == "("){
+                ops.push(i);
+                expectOperand = true;
+            } else if(tok == ")"){
+                bool matched = false;
+                while(!ops.stackEmpty()){
+                    unsigned int o = ops.pop();
+                    if(tokens[o] == "("){
+                        matched = true;
+                        break;
+                    }
+                    output.push_back(opName(tokens, o));
+                }
+                if(!matched)
+                    throw std::invalid_argument("Parentesi non bilanciate");
+                expectOperand = false;
+            } else if(binaryOp(tok) != OP_COUNT){
+                std::string cur = (expectOperand && tok == "-") ? "neg" : tok;
+                if(expectOperand && cur != "neg")
+                    throw std::invalid_argument("Operando mancante prima di " + tok);
+                // "neg" e' associativo a destra, gli altri a sinistra
+                while(!ops.stackEmpty()){
+                    unsigned int o = ops.pop();
+                    std::string top = opName(tokens, o);
+                    if(tokens[o] != "(" && (precedence(top) > precedence(cur) ||
+                       (precedence(top) == precedence(cur) && cur != "neg"))){
+                        output.push_back(top);
+                    } else {
+                        ops.push(o);
+                        break;
+                    }
+                }
+                ops.push(i);
+                expectOperand = true;
+            } else {
+                throw std::invalid_argument("Token non valido: " + tok);
+            }
+        }
+        while(!ops.stackEmpty()){
+            unsigned int o = ops.pop();
+            if(tokens[o] == "(")
+                throw std::invalid_argument("Parentesi non bilanciate");
+            output.push_back(opName(tokens, o));
+        }
+        return output;
+    }
+
+    // Nome dell'operatore di indice o: un "-" in posizione di operando e' unario
+    static std::string opName(const std::vector<std::string> &tokens, unsigned int o) {
+        if(tokens[o] != "-")
+            return tokens[o];
+        if(o == 0)
+            return "neg";
+        const std::string &prev = tokens[o - 1];
+        return (prev == "(" || binaryOp(prev) != OP_COUNT) ? "neg" : "-";
+    }
+
+    // Genera il bytecode da una sequenza RPN e ne verifica la profondita'
+    Program<T> emit(const std::vector<std::string> &rpn) const {
+        Program<T> prog;
+        int depth = 0;
+        for(unsigned int i = 0; i < rpn.size(); ++i){
+            const std::string &tok = rpn[i];
+            Instruction ins;
+            ins.arg = 0;
+            unsigned int bin = binaryOp(tok);
+            if(bin != OP_COUNT){
+                ins.op = bin;
+                depth -= 2;
+            } else if(tok == "neg"){
+                ins.op = OP_NEG;
+                depth -= 1;
+            } else if(isNumber(tok)){
+                ins.op = OP_CONST;
+                ins.arg = static_cast<unsigned int>(prog.constants.size());
+                prog.constants.push_back(static_cast<T>(std::strtod(tok.c_str(), nullptr)));
+            } else if(isIdentifier(tok)){
+                ins.op = OP_LOAD;
+                ins.arg = variableIndex(tok);
+            } else {
+                throw std::invalid_argument("Token non valido: " + tok);
+            }
+            // Ogni operatore deve trovare i suoi operandi sullo stack
+            if(depth < 0)
+                throw std::invalid_argument("Espressione malformata: operandi insufficienti");
+            ++depth;
+            if(static_cast<unsigned int>(depth) > prog.maxDepth)
+                prog.maxDepth = depth;
+            prog.code.push_back(ins);
+        }
+        if(depth != 1)
+            throw std::invalid_argument("Espressione malformata: deve produrre un solo valore");
+        Instruction halt = {OP_HALT, 0};
+        prog.code.push_back(halt);
+        return prog;
+    }
+
+public:
+
+    /**
+      Costruttore parametrico
+      @param vars nomi delle variabili utilizzabili nelle espressioni
+    */
+
+    explicit ExpressionCompiler(const std::vector<std::string> &vars = std::vector<std::string>())
+        : _vars(vars) {}
+
+    /**
+      Compila un'espressione in notazione polacca inversa
+
+      @param expr espressione con token separati da spazi ("neg" per il meno unario)
+
+      @return programma compilato
+
+      @throw std::invalid_argument espressione malformata o variabile sconosciuta
+    */
+
+    Program<T> compileRPN(const std::string &expr) const {
+        std::vector<std::string> rpn;
+        std::istringstream in(expr);
+        std::string tok;
+        while(in >> tok)
+            rpn.push_back(tok);
+        return emit(rpn);
+    }
+
+    /**
+      Compila un'espressione in notazione infissa
+
+      @param expr espressione infissa con parentesi, operatori aritmetici e confronti
+
+      @return programma compilato
+
+      @throw std::invalid_argument espressione malformata o variabile sconosciuta
+    */
+
+    Program<T> compileInfix(const std::string &expr) const {
+        return emit(toRPN(tokenizeInfix(expr)));
+    }
+};
+
+/**
+  @brief Interprete del bytecode
+
+  Valuta un Program su un vettore di variabili. Lo stack degli operandi
+  e' preallocato alla profondita' massima verificata dal compilatore:
+  run() controlla una sola volta che basti, poi push e pop non
+  effettuano controlli. Con GCC/Clang il ciclo di
+  dispatch usa i computed goto, altrimenti uno switch.
+*/
+
+template <typename T>
+class StackVM {
+
+private:
+
+    T * _operands;          ///<stack degli operandi preallocato
+    unsigned int _capacity; ///<celle allocate per gli operandi
+
+    StackVM(const StackVM &);
+    StackVM &operator=(const StackVM &);
+
+    // Divisione: per i tipi interi i casi che solleverebbero SIGFPE
+    // diventano eccezioni
+    static T divide(T a, T b) {
+        if constexpr(std::is_integral<T>::value){
+            if(b == T(0))
+                throw std::domain_error("Divisione per zero");
+            if constexpr(std::is_signed<T>::value){
+                if(b == T(-1) && a == std::numeric_limits<T>::min())
+                    throw std::overflow_error("Overflow nella divisione");
+            }
+        }
+        return a / b;
+    }
+
+public:
+
+    /**
+      Costruttore parametrico
+      @param capacity numero iniziale di celle per lo stack degli operandi
+
+      @throw std::bad_alloc possibile eccezione di allocazione
+    */
+
+    explicit StackVM(unsigned int capacity = 16) : _operands(nullptr), _capacity(capacity) {
+        _operands = new T[_capacity];
+    }
+
+    /**
+      Distruttore
+    */
+
+    ~StackVM(){
+        delete [] _operands;
+    }
+
+    /**
+      Prepara lo stack degli operandi per il programma passato.
+      Va chiamata una volta per programma prima di run().
+
+      @param prog programma da eseguire
+
+      @throw std::bad_alloc possibile eccezione di allocazione
+    */
+
+    void reserve(const Program<T> &prog) {
+        if(prog.maxDepth > _capacity){
+            T *tmp = new T[prog.maxDepth];
+            delete [] _operands;
+            _operands = tmp;
+            _capacity = prog.maxDepth;
+        }
+    }
+
+    /**
+      Esegue un programma
+
+      @param prog programma compilato da ExpressionCompiler
+      @param vars valori delle variabili, indicizzati come nel compilatore
+
+      @return valore dell'espressione
+
+      @throw std::length_error stack degli operandi non preparato con reserve(prog)
+      @throw std::domain_error divisione intera per zero
+      @throw std::overflow_error divisione intera del minimo per -1
+    */
+
+    T run(const Program<T> &prog, const T *vars) const {
+        // Unico controllo sullo stack: la profondita' e' verificata dal compilatore
+        if(prog.maxDepth > _capacity)
+            throw std::length_error("Stack degli operandi insufficiente: chiamare reserve()");
+        const Instruction *ip = prog.code.data();
+        const T *k = prog.constants.data();
+        T *s = _operands;
+        unsigned int n = 0; // elementi sullo stack, la cima e' s[n - 1]
+
+#if defined(__GNUC__)
+        static void *const dispatch[OP_COUNT] = {
+            &&l_const, &&l_load, &&l_add, &&l_sub, &&l_mul, &&l_div, &&l_neg,
+            &&l_lt, &&l_gt, &&l_le, &&l_ge, &&l_eq, &&l_ne, &&l_halt
+        };
+#define VM_NEXT() goto *dispatch[(++ip)->op]
+        goto *dispatch[ip->op];
+    l_const: s[n++] = k[ip->arg];                          VM_NEXT();
+    l_load:  s[n++] = vars[ip->arg];                       VM_NEXT();
+    l_add:   s[n - 2] = s[n - 2] + s[n - 1]; --n;          VM_NEXT();
+    l_sub:   s[n - 2] = s[n - 2] - s[n - 1]; --n;          VM_NEXT();
+    l_mul:   s[n - 2] = s[n - 2] * s[n - 1]; --n;          VM_NEXT();
+    l_div:   s[n - 2] = divide(s[n - 2], s[n - 1]); --n;   VM_NEXT();
+    l_neg:   s[n - 1] = -s[n - 1];                         VM_NEXT();
+    l_lt:    s[n - 2] = T(s[n - 2] <  s[n - 1]); --n;      VM_NEXT();
+    l_gt:    s[n - 2] = T(s[n - 2] >  s[n - 1]); --n;      VM_NEXT();
+    l_le:    s[n - 2] = T(s[n - 2] <= s[n - 1]); --n;      VM_NEXT();
+    l_ge:    s[n - 2] = T(s[n - 2] >= s[n - 1]); --n;      VM_NEXT();
+    l_eq:    s[n - 2] = T(s[n - 2] == s[n - 1]); --n;      VM_NEXT();
+    l_ne:    s[n - 2] = T(s[n - 2] != s[n - 1]); --n;      VM_NEXT();
+    l_halt:  return s[n - 1];
+#undef VM_NEXT
+#else
+        for(;; ++ip){
+            switch(ip->op){
+                case OP_CONST: s[n++] = k[ip->arg]; break;
+                case OP_LOAD:  s[n++] = vars[ip->arg]; break;
+                case OP_ADD:   s[n - 2] = s[n - 2] + s[n - 1]; --n; break;
+                case OP_SUB:   s[n - 2] = s[n - 2] - s[n - 1]; --n; break;
+                case OP_MUL:   s[n - 2] = s[n - 2] * s[n - 1]; --n; break;
+                case OP_DIV:   s[n - 2] = divide(s[n - 2], s[n - 1]); --n; break;
+                case OP_NEG:   s[n - 1] = -s[n - 1]; break;
+                case OP_LT:    s[n - 2] = T(s[n - 2] <  s[n - 1]); --n; break;
+                case OP_GT:    s[n - 2] = T(s[n - 2] >  s[n - 1]); --n; break;
+                case OP_LE:    s[n - 2] = T(s[n - 2] <= s[n - 1]); --n; break;
+                case OP_GE:    s[n - 2] = T(s[n - 2] >= s[n - 1]); --n; break;
+                case OP_EQ:    s[n - 2] = T(s[n - 2] == s[n - 1]); --n; break;
+                case OP_NE:    s[n - 2] = T(s[n - 2] != s[n - 1]); --n; break;
+                default:       return s[n - 1];
+            }
+        }
+#endif
+    }
+};
+
+#endif